@@ -0,0 +1,231 @@
+/*  bench-callback: Time keying a minute of carrier sample by sample and a
+    segment at a time
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "jjyam.h"
+#include "timecode.h"
+#include "wwvbam.h"
+#include "bench.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define BUFFER (512) /* Frames per callback, as in both programs */
+
+/*  One station's carrier, its keying and the state a stream callback keeps
+    while playing one minute. JJY starts each second high and drops to low
+    at the symbol's edge; WWVB starts low, sets the carrier phase from the
+    PM code at 100 ms and rises to high at the edge.
+*/
+typedef struct
+{
+  const char *name;
+  bool wwvb;
+  unsigned long rate;
+  unsigned long period;
+  double low; /* Amplitude of the low signal state */
+  int16_t *first; /* Wavetable played before the edge */
+  int16_t *rest;  /* Wavetable played after it */
+  unsigned long edges[3]; /* Edge of each tc_symbol, in samples */
+  tc_frame frame;
+  uint64_t pm;
+  int second;
+  unsigned long sample_index;
+  unsigned long wt_index;
+  unsigned long edge;
+  uint64_t hash; /* FNV-1a of every sample played */
+} station;
+
+int16_t OUT[BUFFER];
+
+static void
+station_start (station *s)
+{
+  s->second = 0;
+  s->sample_index = 0;
+  s->wt_index = 0;
+  s->edge = s->edges[tc_frame_symbol (&s->frame, 0)];
+  s->hash = 14695981039346656037ULL;
+}
+
+static void
+station_next_second (station *s)
+{
+  s->sample_index = 0;
+  s->second = (s->second + 1) % s->frame.length;
+  s->edge = s->edges[tc_frame_symbol (&s->frame, s->second)];
+}
+
+static void
+per_sample (station *s, unsigned long count)
+{
+  /*  The callbacks before segment rendering: check the phase, the edge,
+      the wavetable index and the end of the second on every sample
+  */
+  unsigned long i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (s->wwvb && s->sample_index == s->rate / 10)
+        {
+          s->wt_index = ((s->pm >> s->second) & 1) ? s->period / 2 : 0;
+        }
+      OUT[i] = (s->sample_index < s->edge) ? s->first[s->wt_index]
+                                           : s->rest[s->wt_index];
+      s->wt_index = (s->wt_index + 1) % s->period;
+      if (++s->sample_index >= s->rate)
+        {
+          station_next_second (s);
+        }
+    }
+}
+
+static void
+segments (station *s, unsigned long count)
+{
+  /*  The callbacks since: copy each run up to the next boundary from a
+      wavetable with tc_render()
+  */
+  unsigned long i = 0;
+  unsigned long end;
+  unsigned long n;
+
+  while (i < count)
+    {
+      if (s->wwvb && s->sample_index == s->rate / 10)
+        {
+          s->wt_index = ((s->pm >> s->second) & 1) ? s->period / 2 : 0;
+        }
+      end = (s->wwvb && s->sample_index < s->rate / 10) ? s->rate / 10
+            : (s->sample_index < s->edge)              ? s->edge
+                                                       : s->rate;
+      n = (end - s->sample_index < count - i) ? end - s->sample_index
+                                               : count - i;
+      s->wt_index = tc_render (&OUT[i], n,
+                               (s->sample_index < s->edge) ? s->first
+                                                           : s->rest,
+                               s->period, s->wt_index, sizeof *OUT);
+      i += n;
+      s->sample_index += n;
+      if (s->sample_index >= s->rate)
+        {
+          station_next_second (s);
+        }
+    }
+}
+
+static void
+play_minute (station *s, void (*callback) (station *, unsigned long),
+             bool hash)
+{
+  /* Play a minute in BUFFER-frame callbacks */
+  unsigned long left = s->rate * s->frame.length;
+  unsigned long n;
+  unsigned long i;
+
+  station_start (s);
+  for (; left > 0; left -= n)
+    {
+      n = (left < BUFFER) ? left : BUFFER;
+      callback (s, n);
+      for (i = 0; hash && i < n; i++)
+        {
+          s->hash = (s->hash ^ (uint16_t)OUT[i]) * 1099511628211ULL;
+        }
+      BENCH_SINK += OUT[n - 1];
+    }
+}
+
+static void
+per_sample_minute (void *arg)
+{
+  play_minute (arg, per_sample, false);
+}
+
+static void
+segments_minute (void *arg)
+{
+  play_minute (arg, segments, false);
+}
+
+static bool
+station_init (station *s)
+{
+  /*  Set up the wavetables at s->rate for one-third of 60kHz, and encode
+      the minute 2024-03-10 07:23 UTC
+  */
+  const double freq = 20000;
+  unsigned int bcd[TC_FIELD_COUNT];
+  struct tm tm;
+  tc_wave w;
+
+  s->period = tc_wavetable_period (s->rate, 60000, 3);
+  tc_wave_init (&w, TC_SINE, freq, s->rate);
+  s->first = tc_wavetable (s->period, freq / s->rate, &w,
+                           s->wwvb ? s->low : 1, TC_INT16, 1);
+  s->rest = tc_wavetable (s->period, freq / s->rate, &w, s->wwvb ? 1 : s->low,
+                          TC_INT16, 1);
+  tc_breakdown (1710055380, &tm);
+  tc_bcd_fields (&tm, bcd);
+  if (s->wwvb)
+    {
+      wwvb_encode_frame (bcd, wwvb_dut1_bits (-3), 60, &s->frame);
+    }
+  else
+    {
+      jjy_encode_frame (bcd, LEAP_NONE, 60, &s->frame);
+    }
+  return s->first != NULL && s->rest != NULL;
+}
+
+int
+main (void)
+{
+  station stations[] = {
+    /* Zero, one and marker are 0.8, 0.5 and 0.2 s high */
+    { .name = "JJY", .rate = 44100, .low = 0.1,
+      .edges = { 35280, 22050, 8820 } },
+    /* Zero, one and marker are 0.2, 0.5 and 0.8 s low */
+    { .name = "WWVB", .wwvb = true, .rate = 48000, .low = 0.02,
+      .edges = { 9600, 24000, 38400 }, .pm = 0x0a5c3f0f1e2d6b59 },
+  };
+  uint64_t hash;
+  bool same = true;
+  size_t k;
+
+  printf ("One minute in %d-frame callbacks, ns/frame:\n", BUFFER);
+  printf ("         per sample  segments\n");
+  for (k = 0; k < sizeof stations / sizeof *stations; k++)
+    {
+      station *s = &stations[k];
+
+      if (!station_init (s))
+        {
+          fprintf (stderr, "Error: Out of memory\n");
+          return 1;
+        }
+      printf ("  %-4s   %10.3f  %8.3f", s->name,
+              bench_run (per_sample_minute, s, s->rate * 60.0),
+              bench_run (segments_minute, s, s->rate * 60.0));
+      play_minute (s, per_sample, true);
+      hash = s->hash;
+      play_minute (s, segments, true);
+      printf ("  %s\n", (s->hash == hash) ? "same samples"
+                                          : "DIFFERENT SAMPLES");
+      same &= s->hash == hash;
+      free (s->first);
+      free (s->rest);
+    }
+  return same ? 0 : 1;
+}
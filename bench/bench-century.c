@@ -0,0 +1,100 @@
+/*  bench-century: Time minute_of_century() against the loop it replaced
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "timecode.h"
+#include "wwvbpm.h"
+#include "bench.h"
+
+#define CALLS (1000) /* Calls per measurement, one for each minute */
+
+static unsigned long
+summed_minute_of_century (const struct tm *t)
+{
+  /*  minute_of_century() as it was first written, summing the length of
+      every year since the start of the century
+  */
+  int year;
+  int first_year;
+  unsigned long total_minutes;
+  int i;
+  const unsigned int minutes_per_day = 1440;
+
+  total_minutes = 0;
+  year = t->tm_year + 1900;
+  first_year = year - (year % 100);
+  for (i = first_year; i < year; i++)
+    {
+      if ((i % 4 == 0) && ((i % 100 == 0) == (i % 400 == 0)))
+        {
+          total_minutes += (366 * minutes_per_day);
+        }
+      else
+        {
+          total_minutes += (365 * minutes_per_day);
+        }
+    }
+  total_minutes += (t->tm_yday * minutes_per_day);
+  total_minutes += (t->tm_hour * 60);
+  total_minutes += t->tm_min;
+  return total_minutes;
+}
+
+typedef struct
+{
+  unsigned long (*fn) (const struct tm *t);
+  struct tm tm;
+} century_call;
+
+static void
+call (void *arg)
+{
+  century_call *c = arg;
+  int i;
+
+  for (i = 0; i < CALLS; i++)
+    {
+      c->tm.tm_min = i % 60;
+      BENCH_SINK += c->fn (&c->tm);
+    }
+}
+
+int
+main (void)
+{
+  century_call closed = { minute_of_century, { 0 } };
+  century_call summed = { summed_minute_of_century, { 0 } };
+  struct tm tm;
+  long mismatches = 0;
+  long day;
+  int year;
+
+  /* Both must agree on the last minute of every day of three centuries */
+  for (day = tc_days_from_civil (1900, 1, 1);
+       day < tc_days_from_civil (2200, 1, 1); day++)
+    {
+      tc_breakdown (day * TC_SECONDS_PER_DAY + TC_SECONDS_PER_DAY - 60, &tm);
+      mismatches += minute_of_century (&tm) != summed_minute_of_century (&tm);
+    }
+  printf ("1900-2199: %ld days where the two differ\n", mismatches);
+  printf ("ns/call    closed form  summed years\n");
+  for (year = 2000; year < 2100; year += 33)
+    {
+      closed.tm.tm_year = summed.tm.tm_year = year - 1900;
+      closed.tm.tm_yday = summed.tm.tm_yday = 200;
+      printf ("  %d  %11.1f  %12.1f\n", year, bench_run (call, &closed, CALLS),
+              bench_run (call, &summed, CALLS));
+    }
+  return (mismatches == 0) ? 0 : 1;
+}
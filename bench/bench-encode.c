@@ -0,0 +1,127 @@
+/*  bench-encode: Time encoding JJY and WWVB minute frames
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "jjyam.h"
+#include "timecode.h"
+#include "wwvbam.h"
+#include "bench.h"
+
+#define MINUTES (1440) /* Frames encoded per call, one day */
+
+/* The day of frames starts here, so that it crosses midnight UTC */
+const time_t START = 1710054000; /* 2024-03-10 07:00 UTC */
+
+typedef enum
+{
+  JJY,
+  WWVB
+} station;
+
+tc_frame FRAME;
+
+static void
+encode (station s, const unsigned int bcd[TC_FIELD_COUNT])
+{
+  if (s == JJY)
+    {
+      jjy_encode_frame (bcd, LEAP_NONE, 60, &FRAME);
+    }
+  else
+    {
+      wwvb_encode_frame (bcd, wwvb_dut1_bits (-3), 60, &FRAME);
+    }
+  BENCH_SINK += FRAME.packed[0] ^ FRAME.packed[1];
+}
+
+static void
+layout_only (void *arg)
+{
+  /* tc_emit() and tc_pack_frame() alone, with fields that never change */
+  const station s = *(const station *)arg;
+  unsigned int bcd[TC_FIELD_COUNT];
+  struct tm tm;
+  uint64_t ones;
+  int i;
+
+  tc_breakdown (START, &tm);
+  tc_bcd_fields (&tm, bcd);
+  for (i = 0; i < MINUTES; i++)
+    {
+      ones = (s == JJY) ? tc_emit (JJY_LAYOUT, JJY_LAYOUT_COUNT, bcd)
+                        : tc_emit (WWVB_LAYOUT, WWVB_LAYOUT_COUNT, bcd);
+      tc_pack_frame (ones, TC_MARKER_SECONDS, 60, &FRAME);
+      BENCH_SINK += FRAME.packed[0] ^ FRAME.packed[1];
+    }
+}
+
+static void
+advanced (void *arg)
+{
+  /*  What the programs do every minute: advance the BCD fields in place,
+      rebuilding them from the calendar only at midnight, and encode the
+      frame
+  */
+  const station s = *(const station *)arg;
+  unsigned int bcd[TC_FIELD_COUNT];
+  struct tm tm;
+  int i;
+
+  tc_breakdown (START, &tm);
+  tc_bcd_fields (&tm, bcd);
+  for (i = 0; i < MINUTES; i++)
+    {
+      if (!tc_advance_minute (bcd))
+        {
+          tc_breakdown (START + i * 60, &tm);
+          tc_bcd_fields (&tm, bcd);
+        }
+      encode (s, bcd);
+    }
+}
+
+static void
+rebuilt (void *arg)
+{
+  /* Break down the time and rebuild every field for every frame */
+  const station s = *(const station *)arg;
+  unsigned int bcd[TC_FIELD_COUNT];
+  struct tm tm;
+  int i;
+
+  for (i = 0; i < MINUTES; i++)
+    {
+      tc_breakdown (START + i * 60, &tm);
+      tc_bcd_fields (&tm, bcd);
+      encode (s, bcd);
+    }
+}
+
+int
+main (void)
+{
+  static const char *NAMES[] = { "JJY", "WWVB" };
+  station s;
+
+  printf ("Minute frames encoded, millions per second:\n");
+  printf ("              layout only  advanced  rebuilt\n");
+  for (s = JJY; s <= WWVB; s++)
+    {
+      printf ("  %-4s        %11.1f %9.1f %8.1f\n", NAMES[s],
+              1e3 / bench_run (layout_only, &s, MINUTES),
+              1e3 / bench_run (advanced, &s, MINUTES),
+              1e3 / bench_run (rebuilt, &s, MINUTES));
+    }
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*  bench-modulate: Time the modulation kernels and the ways of keying a
+    second of carrier
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "modulate.h"
+#include "timecode.h"
+#include "bench.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE (44100)
+#define BUFFER (512)        /* Frames per callback, as in ersatz-jjy */
+#define LOW_AMPLITUDE (0.1) /* Amplitude of the JJY low signal state */
+#define RAMP (RATE / 200)   /* --ramp 5 */
+
+/*  One second of a JJY one symbol at RATE, keyed each of the ways the
+    ersatz-jjy callback has done it
+*/
+int16_t *WT_HIGH;
+int16_t *WT_LOW;
+unsigned long WT_SIZE;
+int16_t ENVELOPE[RATE];
+int16_t OUT[RATE];
+int16_t REFERENCE[RATE];
+
+const char *KERNELS[] = { "scalar", "sse2", "avx2" };
+#define KERNEL_COUNT (sizeof KERNELS / sizeof *KERNELS)
+
+static void
+per_sample (void *arg)
+{
+  /*  The callback loop before seconds were rendered a segment at a time:
+      pick the high or low wavetable afresh for every sample
+  */
+  unsigned long wt_index = 0;
+  unsigned long i;
+
+  (void)arg;
+  for (i = 0; i < RATE; i++)
+    {
+      OUT[i] = (i < RATE / 2) ? WT_HIGH[wt_index] : WT_LOW[wt_index];
+      wt_index = (wt_index + 1) % WT_SIZE;
+    }
+  BENCH_SINK += OUT[RATE - 1];
+}
+
+static void
+segments (void *arg)
+{
+  /*  The default callback: copy each buffer's run of high and low carrier
+      from the wavetables
+  */
+  unsigned long index = 0;
+  unsigned long start;
+  unsigned long end;
+  unsigned long i;
+
+  (void)arg;
+  for (start = 0; start < RATE; start = end)
+    {
+      end = (start + BUFFER < RATE) ? start + BUFFER : RATE;
+      i = (end < RATE / 2) ? end : RATE / 2;
+      if (i > start)
+        {
+          index = tc_render (&OUT[start], i - start, WT_HIGH, WT_SIZE, index,
+                             sizeof *OUT);
+        }
+      else
+        {
+          i = start;
+        }
+      index = tc_render (&OUT[i], end - i, WT_LOW, WT_SIZE, index,
+                         sizeof *OUT);
+    }
+  BENCH_SINK += OUT[RATE - 1];
+}
+
+static void
+enveloped (void *arg)
+{
+  /*  The callback with --ramp: multiply each buffer of high carrier by the
+      second's envelope
+  */
+  unsigned long index = 0;
+  unsigned long start;
+  unsigned long n;
+
+  (void)arg;
+  for (start = 0; start < RATE; start += n)
+    {
+      n = (RATE - start < BUFFER) ? RATE - start : BUFFER;
+      index = mod_render (&OUT[start], n, WT_HIGH, WT_SIZE, index,
+                          &ENVELOPE[start], TC_INT16, 1);
+    }
+  BENCH_SINK += OUT[RATE - 1];
+}
+
+static void
+kernel (void *arg)
+{
+  /* One buffer through the kernel alone */
+  (void)arg;
+  mod_apply (OUT, WT_HIGH, ENVELOPE, BUFFER, TC_INT16);
+  BENCH_SINK += OUT[BUFFER - 1];
+}
+
+static bool
+same_samples (const char *what)
+{
+  /* Compare OUT with REFERENCE, rendered by what, and say so */
+  const bool same = memcmp (REFERENCE, OUT, sizeof OUT) == 0;
+
+  printf ("  %s %s\n", same ? "same samples as" : "DIFFERENT SAMPLES FROM",
+          what);
+  return same;
+}
+
+int
+main (void)
+{
+  tc_wave wave;
+  bool same;
+  size_t k;
+
+  WT_SIZE = tc_wavetable_period (RATE, 60000, 3);
+  tc_wave_init (&wave, TC_SINE, 20000, RATE);
+  WT_HIGH = tc_wavetable (WT_SIZE, 20000.0 / RATE, &wave, 1, TC_INT16, 1);
+  WT_LOW = tc_wavetable (WT_SIZE, 20000.0 / RATE, &wave, LOW_AMPLITUDE,
+                         TC_INT16, 1);
+  if (WT_HIGH == NULL || WT_LOW == NULL)
+    {
+      fprintf (stderr, "Error: Out of memory\n");
+      return 1;
+    }
+  mod_segment (ENVELOPE, RATE / 2, LOW_AMPLITUDE, 1, RAMP);
+  mod_segment (&ENVELOPE[RATE / 2], RATE / 2, 1, LOW_AMPLITUDE, RAMP);
+
+  printf ("One second of a JJY one symbol at %d Hz, in %d-frame buffers, "
+          "ns/frame:\n", RATE, BUFFER);
+  printf ("  per-sample loop (the old callbacks)  %6.3f\n",
+          bench_run (per_sample, NULL, RATE));
+  printf ("  segment copy (default)               %6.3f",
+          bench_run (segments, NULL, RATE));
+  per_sample (NULL);
+  memcpy (REFERENCE, OUT, sizeof OUT);
+  segments (NULL);
+  same = same_samples ("the old loop");
+  for (k = 0; k < KERNEL_COUNT; k++)
+    {
+      if (!mod_use (KERNELS[k]))
+        {
+          continue;
+        }
+      printf ("  enveloped, --ramp 5, %-6s          %6.3f", KERNELS[k],
+              bench_run (enveloped, NULL, RATE));
+      /* Every kernel must give the scalar kernel's samples */
+      enveloped (NULL);
+      if (k == 0)
+        {
+          memcpy (REFERENCE, OUT, sizeof OUT);
+        }
+      same &= same_samples ("scalar");
+    }
+  printf ("Kernel alone, %d samples, ns/sample:\n", BUFFER);
+  for (k = 0; k < KERNEL_COUNT; k++)
+    {
+      if (mod_use (KERNELS[k]))
+        {
+          printf ("  %-6s %6.3f\n", KERNELS[k],
+                  bench_run (kernel, NULL, BUFFER));
+        }
+    }
+  free (WT_HIGH);
+  free (WT_LOW);
+  return same ? 0 : 1;
+}
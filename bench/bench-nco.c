@@ -0,0 +1,144 @@
+/*  bench-nco: Time the NCO against wavetables and measure its accuracy
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "nco.h"
+#include "timecode.h"
+#include "bench.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define BUFFER (512) /* Frames per callback, as in both programs */
+#define TRIM_PPM (1.0)
+
+/*  Sample rates and longwave frequencies whose wavetables for one-third of
+    the frequency range from a few samples to a few hundred thousand
+*/
+typedef struct
+{
+  unsigned long rate;
+  unsigned long num;
+} carrier;
+
+const carrier CARRIERS[] = {
+  { 48000, 60000 }, { 44100, 60000 }, { 44100, 40000 },
+  { 44101, 40000 }, { 96001, 40000 },
+};
+#define CARRIER_COUNT (sizeof CARRIERS / sizeof *CARRIERS)
+
+int16_t OUT[BUFFER];
+
+typedef struct
+{
+  const int16_t *wt;
+  unsigned long period;
+  unsigned long index;
+} wavetable_state;
+
+typedef struct
+{
+  const nco_table *table;
+  uint32_t step;
+  uint32_t phase;
+} nco_state;
+
+static void
+wavetable_buffer (void *arg)
+{
+  wavetable_state *s = arg;
+
+  s->index = tc_render (OUT, BUFFER, s->wt, s->period, s->index, sizeof *OUT);
+  BENCH_SINK += OUT[BUFFER - 1];
+}
+
+static void
+nco_buffer (void *arg)
+{
+  nco_state *s = arg;
+
+  s->phase = nco_render (OUT, BUFFER, s->table, s->phase, s->step, 1);
+  BENCH_SINK += OUT[BUFFER - 1];
+}
+
+static void
+accuracy (const nco_table *table, double freq, unsigned long rate)
+{
+  /*  Compare one second of the NCO trimmed by TRIM_PPM with an ideal sine
+      at the frequency of its phase step
+  */
+  const double PI = acos (-1);
+  const uint32_t step = nco_step (freq * (1 + TRIM_PPM / 1e6), rate);
+  const double cycles = step / 4294967296.0;
+  int16_t *second = malloc (rate * sizeof *second);
+  double worst = 0;
+  double noise = 0;
+  double error;
+  unsigned long i;
+
+  if (second == NULL)
+    {
+      return;
+    }
+  nco_render (second, rate, table, 0, step, 1);
+  for (i = 0; i < rate; i++)
+    {
+      error = second[i] - 32767 * sin (2 * PI * fmod (cycles * i, 1));
+      worst = fmax (worst, fabs (error));
+      noise += error * error;
+    }
+  printf ("%.0f Hz at %lu Hz, trimmed by %+.1f ppm:\n", freq, rate,
+          TRIM_PPM);
+  printf ("  worst error %.1f LSB, SNR %.1f dB, frequency off by %.1e ppm\n",
+          worst, 10 * log10 (32767.0 * 32767 / 2 / (noise / rate)),
+          (cycles * rate / (freq * (1 + TRIM_PPM / 1e6)) - 1) * 1e6);
+  free (second);
+}
+
+int
+main (void)
+{
+  static nco_table table;
+  wavetable_state wt;
+  nco_state nco = { &table, 0, 0 };
+  tc_wave w;
+  double freq;
+  size_t k;
+
+  printf ("%d-sample buffers, ns/sample:\n", BUFFER);
+  for (k = 0; k < CARRIER_COUNT; k++)
+    {
+      freq = CARRIERS[k].num / 3.0;
+      tc_wave_init (&w, TC_SINE, freq, CARRIERS[k].rate);
+      wt.period = tc_wavetable_period (CARRIERS[k].rate, CARRIERS[k].num, 3);
+      wt.index = 0;
+      wt.wt = tc_wavetable (wt.period, freq / CARRIERS[k].rate, &w, 1,
+                            TC_INT16, 1);
+      if (wt.wt == NULL)
+        {
+          fprintf (stderr, "Error: Out of memory\n");
+          return 1;
+        }
+      printf ("  %5.0f Hz at %6lu Hz: wavetable, period %6lu  %6.3f\n", freq,
+              CARRIERS[k].rate, wt.period,
+              bench_run (wavetable_buffer, &wt, BUFFER));
+      free ((void *)wt.wt);
+    }
+  tc_wave_init (&w, TC_SINE, 20000, 44100);
+  nco_table_init (&table, &w, 1, TC_INT16);
+  nco.step = nco_step (20000 * (1 + TRIM_PPM / 1e6), 44100);
+  printf ("  %-49s%6.3f\n", "any carrier: NCO",
+          bench_run (nco_buffer, &nco, BUFFER));
+  accuracy (&table, 20000, 44100);
+  return 0;
+}
@@ -0,0 +1,133 @@
+/*  bench-wave: Measure the harmonics of each waveshape
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "nco.h"
+#include "timecode.h"
+#include "bench.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*  Carriers at one-third of the longwave frequency num, at sample rates
+    where the shapes keep their harmonics and, first, one where they fall
+    back to a sine
+*/
+typedef struct
+{
+  const char *name;
+  unsigned long num;
+  unsigned long rate;
+} carrier;
+
+const carrier CARRIERS[] = {
+  { "JJY 60kHz", 60000, 44100 },   { "JJY 40kHz", 40000, 96000 },
+  { "JJY 60kHz", 60000, 192000 },  { "JJY 40kHz", 40000, 192000 },
+  { "WWVB", 60000, 192000 },
+};
+#define CARRIER_COUNT (sizeof CARRIERS / sizeof *CARRIERS)
+
+static double
+level (const int16_t *x, unsigned long count, double cycles)
+{
+  /*  Amplitude of the component of count samples of x that goes through
+      the given number of cycles in them, relative to a full-scale sine, in
+      dB. Exact when cycles is a whole number.
+  */
+  const double PI = acos (-1);
+  double re = 0;
+  double im = 0;
+  unsigned long i;
+
+  for (i = 0; i < count; i++)
+    {
+      re += x[i] * cos (2 * PI * fmod (cycles * i / count, 1));
+      im -= x[i] * sin (2 * PI * fmod (cycles * i / count, 1));
+    }
+  return 20 * log10 (2 * sqrt (re * re + im * im) / count / 32767 + 1e-12);
+}
+
+static double
+power (const int16_t *x, unsigned long count)
+{
+  /* Total power of count samples of x relative to a full-scale sine, in dB */
+  double sum = 0;
+  unsigned long i;
+
+  for (i = 0; i < count; i++)
+    {
+      sum += (double)x[i] * x[i];
+    }
+  return 10 * log10 (sum / count / (32767.0 * 32767 / 2));
+}
+
+int
+main (void)
+{
+  /*  Wavetables hold a whole number of cycles, so their harmonics are
+      measured over one period exactly. The NCO is measured over one second
+      at the frequency of its phase step.
+  */
+  static const char *SHAPES[] = { "sine", "clipped", "pulse" };
+  static nco_table table;
+  const carrier *c;
+  unsigned long period;
+  unsigned long cycles;
+  double freq;
+  double step_cycles;
+  int16_t *wt;
+  int16_t *second;
+  uint32_t step;
+  tc_wave w;
+  size_t k;
+  int s;
+
+  printf ("dB relative to a full-scale sine:\n");
+  printf ("                              harmonics  first  third   total"
+          "  | NCO first  third\n");
+  for (k = 0; k < CARRIER_COUNT; k++)
+    {
+      c = &CARRIERS[k];
+      freq = c->num / 3.0;
+      period = tc_wavetable_period (c->rate, c->num, 3);
+      cycles = (unsigned long)lround (freq * period / c->rate);
+      step = nco_step (freq, c->rate);
+      step_cycles = step / 4294967296.0 * c->rate;
+      for (s = TC_SINE; s <= TC_PULSE; s++)
+        {
+          tc_wave_init (&w, (tc_shape)s, freq, c->rate);
+          wt = tc_wavetable (period, freq / c->rate, &w, 1, TC_INT16, 1);
+          second = malloc (c->rate * sizeof *second);
+          if (wt == NULL || second == NULL)
+            {
+              fprintf (stderr, "Error: Out of memory\n");
+              return 1;
+            }
+          nco_table_init (&table, &w, 1, TC_INT16);
+          nco_render (second, c->rate, &table, 0, step, 1);
+          printf ("  %-9s at %6lu Hz %-7s %6d %7.2f %6.2f %7.2f  | %9.2f %6.2f"
+                  "\n",
+                  c->name, c->rate, SHAPES[s], w.harmonics,
+                  level (wt, period, cycles),
+                  (6 * cycles < period) ? level (wt, period, 3 * cycles)
+                                        : -INFINITY,
+                  power (wt, period), level (second, c->rate, step_cycles),
+                  (6 * freq < c->rate)
+                      ? level (second, c->rate, 3 * step_cycles)
+                      : -INFINITY);
+          free (wt);
+          free (second);
+        }
+    }
+  return 0;
+}
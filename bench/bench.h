@@ -0,0 +1,61 @@
+/*  bench: Timing for the ersatz-jjy and ersatz-wwvb benchmarks
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_SECONDS (0.5) /* How long each measurement runs for */
+
+/*  Results are added to BENCH_SINK so that the compiler cannot drop the
+    work that produced them
+*/
+static volatile unsigned long BENCH_SINK;
+
+static inline double
+bench_now (void)
+{
+  struct timespec ts;
+
+  timespec_get (&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline double
+bench_run (void (*fn) (void *), void *arg, double units)
+{
+  /*  Call fn (arg) over and over for BENCH_SECONDS, and return the time
+      taken in nanoseconds per unit of work, where one call does units of
+      it
+  */
+  double start;
+  double elapsed;
+  unsigned long calls = 0;
+
+  fn (arg); /* Warm up the caches first */
+  start = bench_now ();
+  do
+    {
+      fn (arg);
+      calls++;
+      elapsed = bench_now () - start;
+    }
+  while (elapsed < BENCH_SECONDS);
+  return elapsed * 1e9 / (calls * units);
+}
+
+#endif /* BENCH_H */
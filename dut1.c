@@ -0,0 +1,182 @@
+/*  dut1: UT1-UTC table for ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "dut1.h"
+#include "timecode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MJD_UNIX_EPOCH (40587L) /* Modified Julian Date of 1970-01-01 */
+#define LINE_CAP (256)
+#define MAX_TENTHS (9) /* |DUT1| is kept below 0.9s by leap seconds */
+
+/*  Columns of the IERS finals format (finals.all, finals.daily,
+    finals2000A.data and so on), counting from 1: the MJD in columns 8-15,
+    an I (IERS) or P (prediction) flag for UT1-UTC in column 58, and UT1-UTC
+    in seconds in columns 59-68. Lines far in the future leave the flag and
+    value blank.
+*/
+#define MJD_COLUMN (8)
+#define MJD_WIDTH (8)
+#define UT1_FLAG_COLUMN (58)
+#define UT1_COLUMN (59)
+#define UT1_WIDTH (10)
+
+static bool
+read_field (const char *line, int column, int width, double *value)
+{
+  /* Parse the number in the given columns of line */
+  char field[LINE_CAP];
+  char *end;
+
+  if ((int)strlen (line) < column - 1 + width)
+    {
+      return false;
+    }
+  memcpy (field, &line[column - 1], width);
+  field[width] = '\0';
+  *value = strtod (field, &end);
+  return end != field;
+}
+
+static int
+round_tenths (double seconds)
+{
+  /* Round to the nearest tenth of a second, within the range WWVB can send */
+  int tenths = (int)(seconds * 10 + ((seconds < 0) ? -0.5 : 0.5));
+
+  if (tenths > MAX_TENTHS)
+    {
+      return MAX_TENTHS;
+    }
+  if (tenths < -MAX_TENTHS)
+    {
+      return -MAX_TENTHS;
+    }
+  return tenths;
+}
+
+bool
+dut1_table_load (dut1_table *dt, const char *path)
+{
+  /*  Read daily UT1-UTC values from an IERS finals file, which combines the
+      observed values and the predictions published in IERS Bulletin A.
+      Both observed and predicted values are used. Returns false if the file
+      cannot be read, is not sorted, or holds no values.
+  */
+  FILE *f;
+  char line[LINE_CAP];
+  double mjd;
+  double ut1;
+  long day;
+  int tenths;
+  dut1_entry *entries;
+
+  dt->entries = NULL;
+  dt->count = 0;
+  dt->last_day = 0;
+  f = fopen (path, "r");
+  if (f == NULL)
+    {
+      return false;
+    }
+  while (fgets (line, LINE_CAP, f) != NULL)
+    {
+      if (!read_field (line, MJD_COLUMN, MJD_WIDTH, &mjd)
+          || (int)strlen (line) < UT1_FLAG_COLUMN
+          || (line[UT1_FLAG_COLUMN - 1] != 'I'
+              && line[UT1_FLAG_COLUMN - 1] != 'P')
+          || !read_field (line, UT1_COLUMN, UT1_WIDTH, &ut1))
+        {
+          continue;
+        }
+      day = (long)mjd - MJD_UNIX_EPOCH;
+      if (dt->count > 0 && day <= dt->last_day)
+        {
+          fprintf (stderr, "Error: %s is not sorted by date\n", path);
+          fclose (f);
+          free (dt->entries);
+          dt->entries = NULL;
+          dt->count = 0;
+          return false;
+        }
+      dt->last_day = day;
+      tenths = round_tenths (ut1);
+      if (dt->count > 0 && dt->entries[dt->count - 1].tenths == tenths)
+        {
+          continue;
+        }
+      entries = realloc (dt->entries, (dt->count + 1) * sizeof *entries);
+      if (entries == NULL)
+        {
+          break;
+        }
+      dt->entries = entries;
+      dt->entries[dt->count].day = day;
+      dt->entries[dt->count].tenths = tenths;
+      dt->count += 1;
+    }
+  fclose (f);
+  return dt->count > 0;
+}
+
+static long
+day_of (time_t t)
+{
+  long days = (long)(t / TC_SECONDS_PER_DAY);
+
+  return (t % TC_SECONDS_PER_DAY < 0) ? days - 1 : days;
+}
+
+bool
+dut1_covers (const dut1_table *dt, time_t t)
+{
+  /* Whether the table gives a value for the UTC day containing t */
+  const long day = day_of (t);
+
+  return dt->count > 0 && day >= dt->entries[0].day && day <= dt->last_day;
+}
+
+int
+dut1_tenths (const dut1_table *dt, time_t t)
+{
+  /*  Return DUT1 in tenths of a second for the UTC day containing t, by
+      binary search for the last run starting on or before that day. Days
+      the table does not cover get a DUT1 of 0.
+  */
+  const long day = day_of (t);
+  int lo = 0;
+  int hi = dt->count;
+  int mid;
+
+  if (!dut1_covers (dt, t))
+    {
+      return 0;
+    }
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (dt->entries[mid].day <= day)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  return dt->entries[lo - 1].tenths;
+}
@@ -0,0 +1,46 @@
+/*  dut1: UT1-UTC table for ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef DUT1_H
+#define DUT1_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/*  A run of days with the same value of DUT1 (UT1-UTC) rounded to a tenth of
+    a second, starting on the given day.
+*/
+typedef struct
+{
+  long day; /* Days since 1970-01-01 */
+  int tenths;
+} dut1_entry;
+
+/*  DUT1 runs sorted by day, as read from an IERS finals file. DUT1 changes
+    by a tenth of a second every few weeks at most, so storing only the days
+    where the rounded value changes keeps the table small.
+*/
+typedef struct
+{
+  dut1_entry *entries;
+  int count;
+  long last_day; /* The last day the file gives a value for */
+} dut1_table;
+
+bool dut1_table_load (dut1_table *dt, const char *path);
+int dut1_tenths (const dut1_table *dt, time_t t);
+bool dut1_covers (const dut1_table *dt, time_t t);
+
+#endif /* DUT1_H */
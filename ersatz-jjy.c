@@ -14,10 +14,18 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>. */
 
 #include "ersatz-jjy-config.h"
+#include "jjyam.h"
+#include "leapsec.h"
+#include "modulate.h"
+#include "nco.h"
 #include "portaudio.h"
+#include "timecode.h"
+#include "tzif.h"
 #include <math.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,565 +33,695 @@
 
 /* Macro constants */
 #define MAX_NANOSEC (1000000000L)
-#define SAMPLE_RATE (44100)
-#define SAMPLE_SCALE (32767) /* Maximum value of an audio sample */
+#define DEFAULT_RATE (44100)
 #define FRAMES_PER_BUFFER (512)
-#define WT_CAP (1323)
 #define NINE_HOURS (32400) /* JST offset from UTC in seconds */
+#define MORSE_UNIT_SAMPLES (SAMPLE_RATE * 3 / 20) /* Length of a Morse dot */
+#define MORSE_EDGE_CAP (16) /* Keying edges in one call sign second */
+#define LOW_AMPLITUDE (0.1) /* Amplitude of the low signal state */
 
 /* Calculated constants */
-const unsigned long JJY_B0_HIGH_SAMPLES = SAMPLE_RATE * 4 / 5;
-const unsigned long JJY_B1_HIGH_SAMPLES = SAMPLE_RATE / 2;
-const unsigned long JJY_M_HIGH_SAMPLES = SAMPLE_RATE / 5;
+/*  The JJY call sign in Morse code. Each dot is one unit of key-down signal
+    and each dash three units, followed by one unit of key-up signal; a space
+    extends that to the three-unit gap between letters.
+*/
+const char JJY_CALL_SIGN_MORSE[] = ".--- .--- -.--";
 
 /* Global variables determined from CLI flags */
-double JJY_FREQ; /* One-third the actual JJY longwave frequency */
-int WT_SIZE;
+unsigned long SAMPLE_RATE;
+tc_format SAMPLE_FORMAT;
+int CHANNELS;       /* 2 with --antiphase, otherwise 1 */
+size_t FRAME_BYTES; /* Bytes in one sample of SAMPLE_FORMAT per channel */
+double JJY_FREQ; /* The JJY longwave frequency, or one-third of it */
+unsigned long WT_SIZE;
 
 /* Global PulseAudio stream reference */
 PaStream *STREAM = NULL;
 
+/* PortAudio sample formats, indexed by tc_format */
+const PaSampleFormat PA_FORMATS[] = { paInt16, paInt24, paInt32, paFloat32 };
+
+/* Leap seconds read at startup from a leap-seconds.list file */
+leap_table LEAP_TABLE;
+tzif_zone LOCAL_ZONE; /* The system time zone, from TZ or /etc/localtime */
+
 /*  Wavetables holding sequential audio samples for high (full amplitude) and
-    low (10% amplitude) signal states. These are populated by
-    populate_jjy_wavetables() at startup, then samples are repeatedly copied
+    low (LOW_AMPLITUDE) signal states. These are populated by
+    jjy_populate_wavetables() at startup, then samples are repeatedly copied
     from them directly into the audio buffer. This eliminates the need for
     performing computationally expensive sine calculations while writing to the
     buffer, allowing for smooth sine-wave playback. The size of the wavetables
     is chosen so that it contains a whole number of sine-wave cycles for the
-    given sample rate; for example, 12 samples at a 48kHz sample rate contain
-    exactly 5 cycles of a 20kHz sine-wave; this ensures that consecutive
-    repetitions of the wavetable encode a continuous sine-wave at a constant
-    frequency.
+    given sample rate, as worked out by tc_wavetable_period(); this ensures
+    that consecutive repetitions of the wavetable encode a continuous
+    sine-wave at a constant frequency. Each wavetable is tiled with tc_tile()
+    so that runs of samples can be copied from it with tc_render(). Samples
+    are held in SAMPLE_FORMAT, so they are copied straight into the audio
+    buffer without conversion.
+*/
+void *WT_HIGH;
+void *WT_LOW;
+
+/*  With --nco or --trim, or when the wavetables would be longer than
+    TC_WAVETABLE_CAP, the carrier is played by a numerically controlled
+    oscillator instead, stepping its phase by NCO_STEP each sample through
+    quarter-wave tables for the high and low signal states. Copying from a
+    wavetable is several times cheaper, so it is used whenever it can be.
+    NCO_STEP is 0 if the wavetables are used.
+*/
+uint32_t NCO_STEP = 0;
+nco_table NCO_HIGH;
+nco_table NCO_LOW;
+
+/*  Keying edges of a second, indexed by tc_symbol: every second starts
+    high and toggles between high and low at each edge, the last of which is
+    the end of the second. Call sign seconds are keyed by JJY_MORSE_EDGES
+    instead. Both are rendered by jjy_populate_edges() for the sample rate.
+*/
+unsigned long JJY_SYMBOL_EDGES[3][2];
+
+/*  With --prerender, the zero, one and marker seconds are rendered once at
+    startup by jjy_populate_seconds(), so the callback plays them with a
+    single copy. A second is not always a whole number of wavetables, so each
+    symbol is rendered once for every phase a second can start in:
+    JJY_PHASES of them, JJY_PHASE_STEP wavetable samples apart. At the
+    default rate and format that comes to about 265KB, or 794KB with
+    --fukushima. Call
+    sign seconds are always rendered live. NULL if seconds are rendered live.
 */
-int16_t WT_HIGH[WT_CAP];
-int16_t WT_LOW[WT_CAP];
+unsigned char *JJY_SECONDS = NULL;
+unsigned long JJY_PHASE_STEP;
+int JJY_PHASES;
+
+/*  With --ramp, the keying edges are shaped with raised-cosine ramps rather
+    than switching between WT_HIGH and WT_LOW: the carrier in WT_HIGH is
+    multiplied by an envelope, one second of which is rendered by
+    jjy_populate_envelopes() for each symbol and each call sign second (about
+    1MB at the default rate). NULL if the edges are not shaped.
+*/
+int16_t *JJY_ENVELOPES = NULL;
+
+/*  Sample-accurate keying edges for the call sign seconds, one row per
+    second, in the same form as JJY_SYMBOL_EDGES, so the audio callback keys
+    the call sign the same way as any other second.
+*/
+unsigned long JJY_MORSE_EDGES[JJY_CALL_SIGN_SECONDS][MORSE_EDGE_CAP];
 
 typedef struct
 {
+  bool antiphase;
+  bool direct;
   bool fukushima;
   bool help;
   bool jst;
+  bool nco;
+  bool prerender;
   bool version;
+  const char *format;
+  const char *leap_file;
+  const char *ramp;
+  const char *rate;
+  const char *trim;
+  const char *wave;
 } jjy_args;
 
 typedef struct
 {
   char short_form;
   char *long_form;
+  char *metavar; /* Name of the flag's argument, or NULL if it takes none */
   char *help_text;
-  void (*setter) (jjy_args *);
+  void (*setter) (jjy_args *, const char *);
 } jjy_cli_flag;
 
 typedef struct
 {
-  time_t seconds;
-  struct tm *local;
+  time_t minute; /* POSIX time at the start of the current minute */
+  unsigned int bcd[TC_FIELD_COUNT]; /* Calendar fields encoded in frame */
+  leap_kind leap; /* Leap second at the end of the current UTC month */
+  tc_frame frame;
+  int second; /* Index of the current second within frame */
   unsigned long sample_index;
   unsigned long wt_index;
-  unsigned long high_samples;
+  uint32_t phase; /* Carrier phase with the NCO engine */
+  const unsigned long *edges; /* Keying edges of the current second */
+  int edge;                   /* Index of the next edge within edges */
+  bool high;                  /* Whether the signal is currently high */
+  const unsigned char *wave;  /* Prerendered current second, or NULL */
+  const int16_t *envelope;    /* Envelope of the current second, or NULL */
+  long offset; /* UTC offset the calendar fields were built with */
+  /*  UTC offset windows, refreshed by the main thread: it fills in the one
+      not in use and then publishes it through zone_index, so the callback
+      never waits on a lock or calls into the C library's time zone code.
+  */
+  tc_zone_window zone[2];
+  atomic_int zone_index;
   bool jst;
 } jjy_data;
 
-/* Functions that calculate individual bits of the JJY time code */
-
-bool
-jjy_b01 (const struct tm *t)
-{
-  return (t->tm_min >= 40);
-}
-
-bool
-jjy_b02 (const struct tm *t)
-{
-  return ((t->tm_min % 40) >= 20);
-}
-
-bool
-jjy_b03 (const struct tm *t)
-{
-  return ((t->tm_min % 20) >= 10);
-}
-
-bool
-jjy_b05 (const struct tm *t)
-{
-  return ((t->tm_min % 10) >= 8);
-}
-
-bool
-jjy_b06 (const struct tm *t)
-{
-  return (((t->tm_min % 10) % 8) >= 4);
-}
-
-bool
-jjy_b07 (const struct tm *t)
+int
+handle_pa_err (PaError err)
 {
-  return (((t->tm_min % 10) % 4) >= 2);
+  Pa_Terminate ();
+  fprintf (stderr, "PortAudio error %d\n", err);
+  fprintf (stderr, "%s\n", Pa_GetErrorText (err));
+  return err;
 }
 
-bool
-jjy_b08 (const struct tm *t)
+void
+jjy_zone_window (bool jst, time_t t, tc_zone_window *w)
 {
-  return ((t->tm_min % 2) > 0);
+  /* Find the UTC offset window starting at t; not for the audio callback */
+  if (jst)
+    {
+      tc_fixed_window (t, NINE_HOURS, w);
+    }
+  else
+    {
+      tzif_window (&LOCAL_ZONE, t, w);
+    }
 }
 
-bool
-jjy_b12 (const struct tm *t)
+void
+jjy_refresh_zone (jjy_data *d)
 {
-  return (t->tm_hour >= 20);
-}
+  /*  Called periodically from the main thread. Once the current window's
+      offset change has passed, find the next one and publish it; the new
+      offset has already been in effect through next_offset meanwhile.
+  */
+  int index = atomic_load_explicit (&d->zone_index, memory_order_relaxed);
 
-bool
-jjy_b13 (const struct tm *t)
-{
-  return ((t->tm_hour % 20) >= 10);
+  if (time (NULL) < d->zone[index].change)
+    {
+      return;
+    }
+  jjy_zone_window (d->jst, d->zone[index].change, &d->zone[1 - index]);
+  atomic_store_explicit (&d->zone_index, 1 - index, memory_order_release);
 }
 
-bool
-jjy_b15 (const struct tm *t)
+void
+jjy_build_fields (jjy_data *d)
 {
-  return ((t->tm_hour % 10) >= 8);
-}
+  /* Rebuild the calendar fields of d->minute in the transmitted zone */
+  struct tm local;
 
-bool
-jjy_b16 (const struct tm *t)
-{
-  return (((t->tm_hour % 10) % 8) >= 4);
+  tc_breakdown (d->minute + d->offset, &local);
+  tc_bcd_fields (&local, d->bcd);
 }
 
-bool
-jjy_b17 (const struct tm *t)
+void
+jjy_next_frame (jjy_data *d)
 {
-  return (((t->tm_hour % 10) % 4) >= 2);
-}
+  /*  Move the frame on to the minute starting at d->minute. Consecutive
+      minutes within a day differ only by a BCD increment of the minute and
+      hour fields, so the previous minute's fields are advanced in place.
+      When the day rolls over or the UTC offset changes, the fields are
+      rebuilt from the calendar instead. d->minute only moves on with the
+      sample clock, which is the only time base once the program has
+      started, so a later step of the system clock is not followed and
+      there is no step to rebuild for.
+  */
+  const tc_zone_window *zone = &d->zone[atomic_load_explicit (
+      &d->zone_index, memory_order_acquire)];
+  long offset = tc_zone_offset (zone, d->minute);
 
-bool
-jjy_b18 (const struct tm *t)
-{
-  return ((t->tm_hour % 2) > 0);
+  if (offset != d->offset || !tc_advance_minute (d->bcd))
+    {
+      d->offset = offset;
+      jjy_build_fields (d);
+    }
+  d->leap = leap_month_state (&LEAP_TABLE, d->minute);
+  jjy_encode_frame (d->bcd, d->leap,
+                    leap_minute_length (&LEAP_TABLE, d->minute), &d->frame);
 }
 
-bool
-jjy_b22 (const struct tm *t)
+int
+jjy_envelope_row (tc_symbol sym, int second)
 {
-  return ((t->tm_yday + 1) >= 200);
+  /* Row of JJY_ENVELOPES for the given symbol sent in the given second */
+  return (sym == TC_CALL_SIGN) ? 3 + second - JJY_CALL_SIGN_FIRST_SEC
+                               : (int)sym;
 }
 
-bool
-jjy_b23 (const struct tm *t)
+void
+jjy_next_second (jjy_data *d)
 {
-  return (((t->tm_yday + 1) % 200) >= 100);
+  /* Look up how the second d->second of the current frame is keyed */
+  const tc_symbol sym = tc_frame_symbol (&d->frame, d->second);
+
+  d->edges = (sym == TC_CALL_SIGN)
+                 ? JJY_MORSE_EDGES[d->second - JJY_CALL_SIGN_FIRST_SEC]
+                 : JJY_SYMBOL_EDGES[sym];
+  d->edge = 0;
+  d->high = true;
+  d->envelope = NULL;
+  if (JJY_ENVELOPES != NULL)
+    {
+      d->envelope = &JJY_ENVELOPES[jjy_envelope_row (sym, d->second)
+                                   * SAMPLE_RATE * CHANNELS];
+    }
+  d->wave = NULL;
+  if (JJY_SECONDS != NULL && sym != TC_CALL_SIGN && d->sample_index == 0)
+    {
+      /* Seconds only ever start in a phase that has been prerendered */
+      d->wave = &JJY_SECONDS[(sym * JJY_PHASES + d->wt_index / JJY_PHASE_STEP)
+                             * SAMPLE_RATE * FRAME_BYTES];
+    }
 }
 
-bool
-jjy_b25 (const struct tm *t)
+static int
+jjy_stream_callback (const void *inputBuffer, void *outputBuffer,
+                     unsigned long framesPerBuffer,
+                     const PaStreamCallbackTimeInfo *timeInfo,
+                     PaStreamCallbackFlags statusFlags, void *userData)
 {
-  return (((t->tm_yday + 1) % 100) >= 80);
-}
+  unsigned char *out = outputBuffer;
+  unsigned long i = 0;
+  unsigned long n;
+  unsigned long end;
+  jjy_data *d = (jjy_data *)userData;
 
-bool
-jjy_b26 (const struct tm *t)
-{
-  return ((((t->tm_yday + 1) % 100) % 80) >= 40);
+  /*  The buffer is filled one run of constant amplitude at a time, up to the
+      next keying edge, so the edges only have to be checked once per run
+      rather than once per sample.
+  */
+  while (i < framesPerBuffer)
+    {
+      if (d->wave != NULL || d->envelope != NULL)
+        {
+          end = SAMPLE_RATE;
+        }
+      else
+        {
+          while (d->sample_index >= d->edges[d->edge])
+            {
+              d->edge += 1;
+              d->high = !d->high;
+            }
+          end = d->edges[d->edge];
+        }
+      n = end - d->sample_index;
+      if (n > framesPerBuffer - i)
+        {
+          n = framesPerBuffer - i;
+        }
+      if (d->wave != NULL)
+        {
+          memcpy (&out[i * FRAME_BYTES],
+                  &d->wave[d->sample_index * FRAME_BYTES], n * FRAME_BYTES);
+          d->wt_index = (d->wt_index + n) % WT_SIZE;
+        }
+      else if (NCO_STEP != 0)
+        {
+          /* With an envelope, high stays true for the whole second */
+          d->phase = nco_render (&out[i * FRAME_BYTES], n,
+                                 d->high ? &NCO_HIGH : &NCO_LOW, d->phase,
+                                 NCO_STEP, CHANNELS);
+          if (d->envelope != NULL)
+            {
+              mod_apply (&out[i * FRAME_BYTES], &out[i * FRAME_BYTES],
+                         &d->envelope[d->sample_index * CHANNELS],
+                         n * CHANNELS, SAMPLE_FORMAT);
+            }
+        }
+      else if (d->envelope != NULL)
+        {
+          d->wt_index = mod_render (&out[i * FRAME_BYTES], n, WT_HIGH,
+                                    WT_SIZE, d->wt_index,
+                                    &d->envelope[d->sample_index * CHANNELS],
+                                    SAMPLE_FORMAT, CHANNELS);
+        }
+      else
+        {
+          d->wt_index = tc_render (&out[i * FRAME_BYTES], n,
+                                   d->high ? WT_HIGH : WT_LOW, WT_SIZE,
+                                   d->wt_index, FRAME_BYTES);
+        }
+      i += n;
+      d->sample_index += n;
+      if (d->sample_index >= SAMPLE_RATE)
+        {
+          /*  Move on to the next second, and on to the next minute once
+              every second of the frame has been played, including any leap
+              second. Here we assume that the time_t type encodes the time as
+              a number of seconds since an arbitrary point in time.
+              Technically this is not specified in the C standard but this is
+              how it is typically implemented in practice.
+          */
+          d->sample_index = 0;
+          d->second += 1;
+          if (d->second >= d->frame.length)
+            {
+              d->minute += 60;
+              jjy_next_frame (d);
+              d->second = 0;
+            }
+          jjy_next_second (d);
+        }
+    }
+  return paContinue;
 }
 
-bool
-jjy_b27 (const struct tm *t)
+void
+jjy_open_local_zone (void)
 {
-  return ((((t->tm_yday + 1) % 100) % 40) >= 20);
+  /*  Read the system time zone the way the C library would. Without one,
+      fall back to UTC, which is also what the C library does.
+  */
+  if (!tzif_open (&LOCAL_ZONE, NULL))
+    {
+      fprintf (stderr, "Warning: Could not read the local time zone, using "
+                       "UTC\n");
+      tzif_open (&LOCAL_ZONE, "UTC0");
+    }
 }
 
 bool
-jjy_b28 (const struct tm *t)
+jjy_populate_wavetables (bool fukushima, bool direct, bool nco, double trim,
+                         tc_shape shape)
 {
-  return (((t->tm_yday + 1) % 20) >= 10);
+  /*  Allocate the wavetables for SAMPLE_RATE in the given waveshape, or set
+      up the NCO if nco is set, the carrier is trimmed by trim parts per
+      million, or the wavetables would be too long. The carrier is one-third
+      of the longwave frequency, relying on the speaker to radiate its third
+      harmonic, or with direct the longwave frequency itself. Returns false
+      if there is not enough memory.
+  */
+  const unsigned long num = fukushima ? 40000 : 60000;
+  const unsigned long den = direct ? 1 : 3;
+  double cycles_per_sample;
+  tc_wave wave;
+
+  JJY_FREQ = (double)num / den;
+  tc_wave_init (&wave, shape, JJY_FREQ, SAMPLE_RATE);
+  WT_SIZE = tc_wavetable_period (SAMPLE_RATE, num, den);
+  if (nco || trim != 0 || WT_SIZE > TC_WAVETABLE_CAP)
+    {
+      NCO_STEP = nco_step (JJY_FREQ * (1 + trim / 1e6), SAMPLE_RATE);
+      nco_table_init (&NCO_HIGH, &wave, 1, SAMPLE_FORMAT);
+      nco_table_init (&NCO_LOW, &wave, LOW_AMPLITUDE, SAMPLE_FORMAT);
+      return true;
+    }
+  cycles_per_sample = (double)JJY_FREQ / (double)SAMPLE_RATE;
+  WT_HIGH = tc_wavetable (WT_SIZE, cycles_per_sample, &wave, 1,
+                          SAMPLE_FORMAT, CHANNELS);
+  WT_LOW = tc_wavetable (WT_SIZE, cycles_per_sample, &wave, LOW_AMPLITUDE,
+                         SAMPLE_FORMAT, CHANNELS);
+  return WT_HIGH != NULL && WT_LOW != NULL;
 }
 
 bool
-jjy_b30 (const struct tm *t)
+jjy_populate_seconds (void)
 {
-  return (((t->tm_yday + 1) % 10) >= 8);
-}
+  /*  Render the zero, one and marker seconds into JJY_SECONDS from the
+      wavetables, in every phase. Returns false if there is not enough
+      memory.
+  */
+  const tc_symbol symbols[] = { TC_ZERO, TC_ONE, TC_MARKER };
+  const unsigned long *edges;
+  unsigned long index;
+  unsigned char *wave;
+  int i;
+  int phase;
 
-bool
-jjy_b31 (const struct tm *t)
-{
-  return ((((t->tm_yday + 1) % 10) % 8) >= 4);
+  /* Seconds start a multiple of gcd (SAMPLE_RATE, WT_SIZE) samples apart */
+  JJY_PHASE_STEP = tc_gcd (SAMPLE_RATE, WT_SIZE);
+  JJY_PHASES = WT_SIZE / JJY_PHASE_STEP;
+  JJY_SECONDS = malloc (3 * JJY_PHASES * SAMPLE_RATE * FRAME_BYTES);
+  if (JJY_SECONDS == NULL)
+    {
+      return false;
+    }
+  for (i = 0; i < 3; i++)
+    {
+      edges = JJY_SYMBOL_EDGES[symbols[i]];
+      for (phase = 0; phase < JJY_PHASES; phase++)
+        {
+          wave = &JJY_SECONDS[(symbols[i] * JJY_PHASES + phase) * SAMPLE_RATE
+                              * FRAME_BYTES];
+          if (JJY_ENVELOPES != NULL)
+            {
+              mod_render (wave, SAMPLE_RATE, WT_HIGH, WT_SIZE,
+                          phase * JJY_PHASE_STEP,
+                          &JJY_ENVELOPES[symbols[i] * SAMPLE_RATE * CHANNELS],
+                          SAMPLE_FORMAT, CHANNELS);
+              continue;
+            }
+          index = tc_render (wave, edges[0], WT_HIGH, WT_SIZE,
+                             phase * JJY_PHASE_STEP, FRAME_BYTES);
+          tc_render (&wave[edges[0] * FRAME_BYTES], SAMPLE_RATE - edges[0],
+                     WT_LOW, WT_SIZE, index, FRAME_BYTES);
+        }
+    }
+  return true;
 }
 
-bool
-jjy_b32 (const struct tm *t)
+double
+jjy_build_envelope (int16_t *envelope, const unsigned long *edges,
+                    double from, unsigned long ramp)
 {
-  return ((((t->tm_yday + 1) % 10) % 4) >= 2);
-}
+  /*  Render one second keyed at the given edges into envelope, ramping from
+      amplitude from at the end of the previous second. Returns the
+      amplitude at the end of the second.
+  */
+  unsigned long pos = 0;
+  bool high = true;
+  int i;
 
-bool
-jjy_b33 (const struct tm *t)
-{
-  return (((t->tm_yday + 1) % 2) > 0);
+  for (i = 0;; i++)
+    {
+      if (edges[i] > pos)
+        {
+          mod_segment (&envelope[pos], edges[i] - pos, from,
+                       high ? 1.0 : LOW_AMPLITUDE, ramp);
+          from = high ? 1.0 : LOW_AMPLITUDE;
+          pos = edges[i];
+        }
+      if (edges[i] >= SAMPLE_RATE)
+        {
+          return from;
+        }
+      high = !high;
+    }
 }
 
 bool
-jjy_b36 (const struct tm *t)
+jjy_populate_envelopes (unsigned long ramp)
 {
-  /*  Even parity over time code bits 12-18. Bit 14 has a constant value of 0
-      and therefore does not affect the calculation. The result is effectively
-      an XOR of all bits in the range.
+  /*  Render JJY_ENVELOPES with ramps of the given number of samples.
+      Returns false if there is not enough memory.
   */
-  bool even_parity = false;
-  even_parity = (even_parity != jjy_b12 (t));
-  even_parity = (even_parity != jjy_b13 (t));
-  even_parity = (even_parity != jjy_b15 (t));
-  even_parity = (even_parity != jjy_b16 (t));
-  even_parity = (even_parity != jjy_b17 (t));
-  even_parity = (even_parity != jjy_b18 (t));
-  return even_parity;
+  double from = LOW_AMPLITUDE;
+  int sym;
+  int sec;
+  int16_t *row;
+
+  JJY_ENVELOPES = malloc ((3 + JJY_CALL_SIGN_SECONDS) * SAMPLE_RATE * CHANNELS
+                          * sizeof *JJY_ENVELOPES);
+  if (JJY_ENVELOPES == NULL)
+    {
+      return false;
+    }
+  /* Zero, one and marker seconds always follow a second that ends low */
+  for (sym = TC_ZERO; sym <= TC_MARKER; sym++)
+    {
+      row = &JJY_ENVELOPES[sym * SAMPLE_RATE * CHANNELS];
+      jjy_build_envelope (row, JJY_SYMBOL_EDGES[sym], LOW_AMPLITUDE, ramp);
+      mod_spread (row, SAMPLE_RATE, CHANNELS);
+    }
+  for (sec = 0; sec < JJY_CALL_SIGN_SECONDS; sec++)
+    {
+      row = &JJY_ENVELOPES[jjy_envelope_row (TC_CALL_SIGN,
+                                             JJY_CALL_SIGN_FIRST_SEC + sec)
+                           * SAMPLE_RATE * CHANNELS];
+      from = jjy_build_envelope (row, JJY_MORSE_EDGES[sec], from, ramp);
+      mod_spread (row, SAMPLE_RATE, CHANNELS);
+    }
+  return true;
 }
 
-bool
-jjy_b37 (const struct tm *t)
+void
+jjy_populate_edges (void)
 {
-  /*  Even parity over time code bits 1-8. Bit 4 has a constant value of 0 and
-      therefore does not affect the calculation.
+  /*  Fill in JJY_SYMBOL_EDGES for SAMPLE_RATE, and render
+      JJY_CALL_SIGN_MORSE into JJY_MORSE_EDGES, starting at the beginning of
+      second 40. Any time left over after the call sign is key-up.
   */
-  bool even_parity = false;
-  even_parity = (even_parity != jjy_b01 (t));
-  even_parity = (even_parity != jjy_b02 (t));
-  even_parity = (even_parity != jjy_b03 (t));
-  even_parity = (even_parity != jjy_b05 (t));
-  even_parity = (even_parity != jjy_b06 (t));
-  even_parity = (even_parity != jjy_b07 (t));
-  even_parity = (even_parity != jjy_b08 (t));
-  return even_parity;
-}
-
-bool
-jjy_b41 (const struct tm *t)
-{
-  return ((t->tm_year % 100) >= 80);
-}
-
-bool
-jjy_b42 (const struct tm *t)
-{
-  return (((t->tm_year % 100) % 80) >= 40);
-}
-
-bool
-jjy_b43 (const struct tm *t)
-{
-  return (((t->tm_year % 100) % 40) >= 20);
-}
+  unsigned long toggles[2 * sizeof JJY_CALL_SIGN_MORSE];
+  unsigned long pos = 0;
+  unsigned long start;
+  int count = 0;
+  int sec;
+  int i;
+  int n;
+  bool key;
 
-bool
-jjy_b44 (const struct tm *t)
-{
-  return ((t->tm_year % 20) >= 10);
-}
+  JJY_SYMBOL_EDGES[TC_ZERO][0] = SAMPLE_RATE * 4 / 5;
+  JJY_SYMBOL_EDGES[TC_ONE][0] = SAMPLE_RATE / 2;
+  JJY_SYMBOL_EDGES[TC_MARKER][0] = SAMPLE_RATE / 5;
+  for (i = TC_ZERO; i <= TC_MARKER; i++)
+    {
+      JJY_SYMBOL_EDGES[i][1] = SAMPLE_RATE;
+    }
 
-bool
-jjy_b45 (const struct tm *t)
-{
-  return ((t->tm_year % 10) >= 8);
+  /* Sample positions where the key goes down (even) or up (odd) */
+  for (i = 0; JJY_CALL_SIGN_MORSE[i] != '\0'; i++)
+    {
+      if (JJY_CALL_SIGN_MORSE[i] == ' ')
+        {
+          pos += 2 * MORSE_UNIT_SAMPLES;
+          continue;
+        }
+      toggles[count++] = pos;
+      pos += ((JJY_CALL_SIGN_MORSE[i] == '-') ? 3 : 1) * MORSE_UNIT_SAMPLES;
+      toggles[count++] = pos;
+      pos += MORSE_UNIT_SAMPLES;
+    }
+  for (sec = 0; sec < JJY_CALL_SIGN_SECONDS; sec++)
+    {
+      /*  Every second starts high, so one that starts with the key up
+          toggles to low straight away.
+      */
+      start = (unsigned long)sec * SAMPLE_RATE;
+      key = false;
+      n = 0;
+      for (i = 0; i < count && toggles[i] <= start; i++)
+        {
+          key = !key;
+        }
+      if (!key)
+        {
+          JJY_MORSE_EDGES[sec][n++] = 0;
+        }
+      for (; i < count && toggles[i] < start + SAMPLE_RATE; i++)
+        {
+          JJY_MORSE_EDGES[sec][n++] = toggles[i] - start;
+        }
+      JJY_MORSE_EDGES[sec][n] = SAMPLE_RATE;
+    }
 }
 
-bool
-jjy_b46 (const struct tm *t)
-{
-  return (((t->tm_year % 10) % 8) >= 4);
-}
+/* CLI flag setter functions */
 
-bool
-jjy_b47 (const struct tm *t)
+void
+antiphase_flag_setter (jjy_args *argsp, const char *value)
 {
-  return (((t->tm_year % 10) % 4) >= 2);
+  argsp->antiphase = true;
 }
 
-bool
-jjy_b48 (const struct tm *t)
+void
+direct_flag_setter (jjy_args *argsp, const char *value)
 {
-  return ((t->tm_year % 2) > 0);
+  argsp->direct = true;
 }
 
-bool
-jjy_b50 (const struct tm *t)
+void
+format_flag_setter (jjy_args *argsp, const char *value)
 {
-  return (t->tm_wday >= 4);
+  argsp->format = value;
 }
 
-bool
-jjy_b51 (const struct tm *t)
+void
+fukushima_flag_setter (jjy_args *argsp, const char *value)
 {
-  return ((t->tm_wday % 4) >= 2);
+  argsp->fukushima = true;
 }
 
-bool
-jjy_b52 (const struct tm *t)
-{
-  return ((t->tm_wday % 2) > 0);
-}
-
-/*  Bits 53 and 54 have function stubs here because they should warn about
-    upcoming leap seconds. A bit 53 value of 1 (true) indicates that the
-    current UTC month ends with a leap second; if a leap second is upcoming
-    then bit 54 indicates whether it will be a positive leap second (1) or a
-    negative leap second (0). In practice, negative leap seconds have never
-    been implemented by international timekeeping bodies, and as of 2024 it
-    appears likely that no more leap seconds of either kind will occur before
-    they are scheduled to be phased out in 2035. Furthermore, many
-    implementations of the time_t type that stores datetimes in C (especially
-    on POSIX systems) are not leap second-aware and therefore do not allow C
-    code to discover upcoming leap econds, so implementing these would require
-    code from outside the C standard libraries, for example by incorporating
-    C++20 standard libraries.
-*/
-
-bool
-jjy_b53 (const struct tm *t)
+void
+help_flag_setter (jjy_args *argsp, const char *value)
 {
-  return false;
+  argsp->help = true;
 }
 
-bool
-jjy_b54 (const struct tm *t)
+void
+jst_flag_setter (jjy_args *argsp, const char *value)
 {
-  return false;
+  argsp->jst = true;
 }
 
-unsigned long
-sec_high_samples (const struct tm *t)
+void
+leap_file_flag_setter (jjy_args *argsp, const char *value)
 {
-  /*  Return the number of high (full amplitude) samples that should be played
-      at the start of the second represented by t. The length of the high
-      signal at the start of each second represents either a 0 bit, a 1 bit,
-      or a marker that allows the receiver to recognize the structure of the
-      time code and where the encoded minute begins and ends.
-
-      In the real JJY time code, minutes 15 and 45 of every hour follow an
-      altered format where bits 41-48 are replaced by a Morse code station
-      identifier and bits 50 through 55 are replaced by bits providing
-      information about upcoming planned service interruptions. This program
-      does not replicate this behavior and instead follows the same format
-      for all other minutes of the hour during minutes 15 and 45, expecting
-      the receiver to ignore information in the affected time-frames.
-  */
-
-  /*  Lookup table for functions that determine bit value for each second;
-      a null pointer is provided for seconds that encode markers or a constant
-      value of zero.
-  */
-  bool (*jjy_bit_func[]) (const struct tm *) = {
-    NULL,    jjy_b01, jjy_b02, jjy_b03, NULL,    jjy_b05, jjy_b06, jjy_b07,
-    jjy_b08, NULL,    NULL,    NULL,    jjy_b12, jjy_b13, NULL,    jjy_b15,
-    jjy_b16, jjy_b17, jjy_b18, NULL,    NULL,    NULL,    jjy_b22, jjy_b23,
-    NULL,    jjy_b25, jjy_b26, jjy_b27, jjy_b28, NULL,    jjy_b30, jjy_b31,
-    jjy_b32, jjy_b33, NULL,    NULL,    jjy_b36, jjy_b37, NULL,    NULL,
-    NULL,    jjy_b41, jjy_b42, jjy_b43, jjy_b44, jjy_b45, jjy_b46, jjy_b47,
-    jjy_b48, NULL,    jjy_b50, jjy_b51, jjy_b52, jjy_b53, jjy_b54, NULL,
-    NULL,    NULL,    NULL,    NULL,    NULL /* Second 60, a leap second */
-  };
-
-  switch (t->tm_sec)
-    {
-    /*  This code does not correctly implement leap seconds; if a minute
-        ends in a positive leap second, then second 59 should encode a value
-        of 0, instead of a marker as it does during any other minute.
-        Conversely, if a minute ends with a negative leap second, then
-        second 58 should encode a marker instead of its usual value of 0.
-        Although the C11 standard allows a minute with 61 seconds according
-        to the struct tm type, the underlying implementation of the time_t
-        type that canonically represents a datetime is often incapable of
-        representing leap seconds.
-    */
-    case 0:
-    case 9:
-    case 19:
-    case 29:
-    case 39:
-    case 49:
-    case 59:
-    case 60: /* Leap second */
-      /* These seconds of the 60-second time code encode markers */
-      return JJY_M_HIGH_SAMPLES;
-    case 4:
-    case 10:
-    case 11:
-    case 14:
-    case 20:
-    case 21:
-    case 24:
-    case 34:
-    case 35:
-    case 38:
-    case 40:
-    case 55:
-    case 56:
-    case 57:
-    case 58:
-      /* These seconds of the 60-second time code always encode 0 */
-      return JJY_B0_HIGH_SAMPLES;
-    case 1:
-    case 2:
-    case 3:
-    case 5:
-    case 6:
-    case 7:
-    case 8:
-    case 12:
-    case 13:
-    case 15:
-    case 16:
-    case 17:
-    case 18:
-    case 22:
-    case 23:
-    case 25:
-    case 26:
-    case 27:
-    case 28:
-    case 30:
-    case 31:
-    case 32:
-    case 33:
-    case 36:
-    case 37:
-    case 41:
-    case 42:
-    case 43:
-    case 44:
-    case 45:
-    case 46:
-    case 47:
-    case 48:
-    case 50:
-    case 51:
-    case 52:
-    case 53:
-    case 54:
-      /* These seconds encode variable bits with time information */
-      return (jjy_bit_func[t->tm_sec](t) ? JJY_B1_HIGH_SAMPLES
-                                         : JJY_B0_HIGH_SAMPLES);
-    default:
-      /* In practice, this block should be unreachable */
-      return JJY_B0_HIGH_SAMPLES;
-    }
+  argsp->leap_file = value;
 }
 
-int
-handle_pa_err (PaError err)
+void
+nco_flag_setter (jjy_args *argsp, const char *value)
 {
-  Pa_Terminate ();
-  fprintf (stderr, "PortAudio error %d\n", err);
-  fprintf (stderr, "%s\n", Pa_GetErrorText (err));
-  return err;
+  argsp->nco = true;
 }
 
-struct tm *
-get_tm (time_t *t, bool jst)
+void
+prerender_flag_setter (jjy_args *argsp, const char *value)
 {
-  time_t t_with_offset = *t;
-
-  if (jst)
-    {
-      t_with_offset += NINE_HOURS;
-      return gmtime (&t_with_offset);
-    }
-  return localtime (&t_with_offset);
-}
-
-static int
-jjy_stream_callback (const void *inputBuffer, void *outputBuffer,
-                     unsigned long framesPerBuffer,
-                     const PaStreamCallbackTimeInfo *timeInfo,
-                     PaStreamCallbackFlags statusFlags, void *userData)
-{
-  int16_t *out = (int16_t *)outputBuffer;
-  unsigned long i;
-  jjy_data *d = (jjy_data *)userData;
-
-  for (i = 0; i < framesPerBuffer; i++)
-    {
-      if (d->sample_index < d->high_samples)
-        {
-          out[i] = WT_HIGH[d->wt_index];
-        }
-      else
-        {
-          out[i] = WT_LOW[d->wt_index];
-        }
-      d->wt_index = (d->wt_index + 1) % WT_SIZE;
-      d->sample_index += 1;
-      if (d->sample_index >= SAMPLE_RATE)
-        {
-          /*  Move on to the next second. Here we assume that the time_t type
-              encodes the time as a number of seconds since an arbitrary point
-              in time. Technically this is not specified in the C standard but
-              this is how it is typically implemented in practice.
-          */
-          d->seconds += 1;
-          d->sample_index = 0;
-          d->local = get_tm (&d->seconds, d->jst);
-          d->high_samples = sec_high_samples (d->local);
-        }
-    }
-  return paContinue;
+  argsp->prerender = true;
 }
 
 void
-jjy_populate_wavetables (int16_t WT_HIGH[WT_CAP], int16_t WT_LOW[WT_CAP],
-                         bool fukushima)
+ramp_flag_setter (jjy_args *argsp, const char *value)
 {
-  JJY_FREQ = fukushima ? (40000.0 / 3.0) : 20000.0;
-  WT_SIZE = fukushima ? 1323 : 441;
-  const double PI = acos (-1);
-  const double cycles_per_sample = (double)JJY_FREQ / (double)SAMPLE_RATE;
-  int i;
-
-  for (i = 0; i < WT_SIZE; i++)
-    {
-      WT_HIGH[i]
-          = SAMPLE_SCALE * sin ((double)i * 2.0 * PI * cycles_per_sample);
-    }
-  for (i = 0; i < WT_SIZE; i++)
-    {
-      WT_LOW[i] = SAMPLE_SCALE * 0.1
-                  * sin ((double)i * 2.0 * PI * cycles_per_sample);
-    }
+  argsp->ramp = value;
 }
 
-/* CLI flag setter functions */
-
 void
-fukushima_flag_setter (jjy_args *argsp)
+rate_flag_setter (jjy_args *argsp, const char *value)
 {
-  argsp->fukushima = true;
+  argsp->rate = value;
 }
 
 void
-help_flag_setter (jjy_args *argsp)
+trim_flag_setter (jjy_args *argsp, const char *value)
 {
-  argsp->help = true;
+  argsp->trim = value;
 }
 
 void
-jst_flag_setter (jjy_args *argsp)
+version_flag_setter (jjy_args *argsp, const char *value)
 {
-  argsp->jst = true;
+  argsp->version = true;
 }
 
 void
-version_flag_setter (jjy_args *argsp)
+wave_flag_setter (jjy_args *argsp, const char *value)
 {
-  argsp->version = true;
+  argsp->wave = value;
 }
 
 const jjy_cli_flag cli_flags[]
-    = { { 'f', "fukushima", "simulate 40kHz signal", fukushima_flag_setter },
-        { 'h', "help", "show this help message and exit", help_flag_setter },
-        { 'j', "jst", "force JST timezone", jst_flag_setter },
-        { 'v', "version", "print version number and exit",
-          version_flag_setter } };
+    = { { 'a', "antiphase", NULL,
+          "play the signal on two channels in antiphase",
+          antiphase_flag_setter },
+        { 'D', "direct", NULL,
+          "synthesize the longwave frequency itself, at 192kHz by default",
+          direct_flag_setter },
+        { 'F', "format", "FORMAT",
+          "output int16 (default), int24, int32 or float32 samples",
+          format_flag_setter },
+        { 'f', "fukushima", NULL, "simulate 40kHz signal",
+          fukushima_flag_setter },
+        { 'h', "help", NULL, "show this help message and exit",
+          help_flag_setter },
+        { 'j', "jst", NULL, "force JST timezone", jst_flag_setter },
+        { 'l', "leap-file", "PATH", "read leap seconds from PATH",
+          leap_file_flag_setter },
+        { 'n', "nco", NULL,
+          "play the carrier with an NCO rather than a wavetable",
+          nco_flag_setter },
+        { 'p', "prerender", NULL,
+          "prerender each kind of second, using more memory",
+          prerender_flag_setter },
+        { 'r', "ramp", "MS", "shape keying edges with MS millisecond ramps",
+          ramp_flag_setter },
+        { 'R', "rate", "HZ", "output audio at HZ samples per second",
+          rate_flag_setter },
+        { 't', "trim", "PPM",
+          "trim the carrier frequency by PPM parts per million",
+          trim_flag_setter },
+        { 'v', "version", NULL, "print version number and exit",
+          version_flag_setter },
+        { 'w', "wave", "SHAPE",
+          "shape the carrier as a sine (default), clipped sine or pulse",
+          wave_flag_setter } };
 const int flags_count = (sizeof cli_flags) / (sizeof *cli_flags);
 
 bool
@@ -597,9 +735,19 @@ parse_jjy_args (jjy_args *argsp, int argc, const char *argv[])
   jjy_cli_flag *flag;
 
   argsp->help = false;
+  argsp->antiphase = false;
+  argsp->direct = false;
   argsp->fukushima = false;
   argsp->jst = false;
+  argsp->nco = false;
+  argsp->prerender = false;
   argsp->version = false;
+  argsp->format = NULL;
+  argsp->leap_file = NULL;
+  argsp->ramp = NULL;
+  argsp->rate = NULL;
+  argsp->trim = NULL;
+  argsp->wave = NULL;
   for (i = 1; i < argc; i++)
     {
       arg_parsed = false;
@@ -609,8 +757,15 @@ parse_jjy_args (jjy_args *argsp, int argc, const char *argv[])
             {
               if (strcmp (cli_flags[j].long_form, &argv[i][2]) == 0)
                 {
+                  if (cli_flags[j].metavar != NULL && i + 1 >= argc)
+                    {
+                      fprintf (stderr, "Error: CLI flag %s requires %s\n",
+                               argv[i], cli_flags[j].metavar);
+                      return false;
+                    }
                   arg_parsed = true;
-                  cli_flags[j].setter (argsp);
+                  cli_flags[j].setter (
+                      argsp, (cli_flags[j].metavar != NULL) ? argv[++i] : NULL);
                   break;
                 }
             }
@@ -623,12 +778,37 @@ parse_jjy_args (jjy_args *argsp, int argc, const char *argv[])
               flag_char_parsed = false;
               for (k = 0; k < flags_count; k++)
                 {
-                  if (argv[i][j] == cli_flags[k].short_form)
+                  if (argv[i][j] != cli_flags[k].short_form)
+                    {
+                      continue;
+                    }
+                  flag_char_parsed = true;
+                  if (cli_flags[k].metavar == NULL)
                     {
-                      flag_char_parsed = true;
-                      cli_flags[k].setter (argsp);
+                      cli_flags[k].setter (argsp, NULL);
                       break;
                     }
+                  /*  A flag that takes an argument ends the group of short
+                      flags, and its argument is either the rest of this
+                      CLI argument or the next one.
+                  */
+                  if (argv[i][j + 1] != '\0')
+                    {
+                      cli_flags[k].setter (argsp, &argv[i][j + 1]);
+                    }
+                  else if (i + 1 < argc)
+                    {
+                      cli_flags[k].setter (argsp, argv[++i]);
+                    }
+                  else
+                    {
+                      fprintf (stderr, "Error: CLI flag -%c requires %s\n",
+                               cli_flags[k].short_form,
+                               cli_flags[k].metavar);
+                      return false;
+                    }
+                  j = strlen (argv[i]) - 1;
+                  break;
                 }
               if (!flag_char_parsed)
                 {
@@ -655,11 +835,24 @@ print_help (const char *ename)
   int i;
   int j;
   int spaces;
+  int width;
+  int column = 0;
 
   printf ("usage: %s", display_name);
   for (i = 0; i < flags_count; i++)
     {
-      printf (" [-%c]", cli_flags[i].short_form);
+      if (cli_flags[i].metavar != NULL)
+        {
+          printf (" [-%c %s]", cli_flags[i].short_form, cli_flags[i].metavar);
+          width = strlen (cli_flags[i].long_form)
+                  + strlen (cli_flags[i].metavar) + 1;
+        }
+      else
+        {
+          printf (" [-%c]", cli_flags[i].short_form);
+          width = strlen (cli_flags[i].long_form);
+        }
+      column = (width + 2 > column) ? width + 2 : column;
     }
   printf ("\n\n");
   printf ("Output audio simulating JJY radio time signal\n\n");
@@ -667,7 +860,12 @@ print_help (const char *ename)
   for (i = 0; i < flags_count; i++)
     {
       printf ("  -%c, --%s", cli_flags[i].short_form, cli_flags[i].long_form);
-      spaces = 11 - strlen (cli_flags[i].long_form);
+      spaces = column - strlen (cli_flags[i].long_form);
+      if (cli_flags[i].metavar != NULL)
+        {
+          printf (" %s", cli_flags[i].metavar);
+          spaces -= strlen (cli_flags[i].metavar) + 1;
+        }
       for (j = 0; j < spaces; j++)
         {
           printf (" ");
@@ -701,7 +899,11 @@ main (int argc, const char *argv[])
   jjy_args args;
   PaStreamParameters outputParameters;
   PaError err = paNoError;
-  struct timespec now;
+  leap_utc now;
+  const char *leap_path;
+  unsigned long ramp = 0;
+  double trim = 0;
+  tc_shape shape = TC_SINE;
   jjy_data data;
 
   if (!parse_jjy_args (&args, argc, argv))
@@ -719,18 +921,116 @@ main (int argc, const char *argv[])
       return 0;
     }
   data.jst = args.jst;
+  SAMPLE_RATE = args.direct ? TC_DIRECT_RATE : DEFAULT_RATE;
+  if (args.rate != NULL && !tc_parse_rate (args.rate, &SAMPLE_RATE))
+    {
+      fprintf (stderr, "Error: Invalid sample rate %s, expected %d to %d Hz\n",
+               args.rate, TC_MIN_RATE, TC_MAX_RATE);
+      return 1;
+    }
+  SAMPLE_FORMAT = TC_INT16;
+  if (args.format != NULL && !tc_parse_format (args.format, &SAMPLE_FORMAT))
+    {
+      fprintf (stderr, "Error: Invalid sample format %s\n", args.format);
+      return 1;
+    }
+  if (args.wave != NULL && !tc_parse_shape (args.wave, &shape))
+    {
+      fprintf (stderr, "Error: Invalid waveshape %s\n", args.wave);
+      return 1;
+    }
+  if (args.direct && shape != TC_SINE)
+    {
+      fprintf (stderr, "Warning: Waveshapes only help a carrier at one-third "
+                       "of the longwave frequency, playing a sine\n");
+      shape = TC_SINE;
+    }
+  CHANNELS = args.antiphase ? 2 : 1;
+  FRAME_BYTES = tc_sample_size (SAMPLE_FORMAT) * CHANNELS;
+  if (args.ramp != NULL && !mod_parse_ramp (args.ramp, SAMPLE_RATE, &ramp))
+    {
+      fprintf (stderr, "Error: Invalid ramp length %s, expected 0 to %d ms\n",
+               args.ramp, MOD_MAX_RAMP_MS);
+      return 1;
+    }
+  if (args.trim != NULL && !nco_parse_trim (args.trim, &trim))
+    {
+      fprintf (stderr, "Error: Invalid trim %s, expected -%d to %d ppm\n",
+               args.trim, NCO_MAX_TRIM_PPM, NCO_MAX_TRIM_PPM);
+      return 1;
+    }
 
   printf ("ersatz-jjy v%d.%d\n", ERSATZ_JJY_VERSION_MAJOR,
           ERSATZ_JJY_VERSION_MINOR);
-  jjy_populate_wavetables (WT_HIGH, WT_LOW, args.fukushima);
+  leap_path = (args.leap_file != NULL) ? args.leap_file : LEAP_DEFAULT_PATH;
+  if (!leap_table_load (&LEAP_TABLE, leap_path))
+    {
+      if (args.leap_file != NULL)
+        {
+          fprintf (stderr, "Error: Could not read leap seconds from %s\n",
+                   leap_path);
+          return 1;
+        }
+      fprintf (stderr, "Warning: Could not read %s, leap seconds will not be "
+                       "announced\n",
+               leap_path);
+    }
+  else if (LEAP_TABLE.expires != 0 && LEAP_TABLE.expires < time (NULL))
+    {
+      fprintf (stderr, "Warning: Leap second list %s has expired\n",
+               leap_path);
+    }
+  if (!args.jst)
+    {
+      jjy_open_local_zone ();
+    }
+  if (!jjy_populate_wavetables (args.fukushima, args.direct, args.nco, trim,
+                                shape))
+    {
+      fprintf (stderr, "Error: Not enough memory for the wavetables\n");
+      return 1;
+    }
+  if (SAMPLE_RATE <= 2 * JJY_FREQ)
+    {
+      fprintf (stderr, "Error: A sample rate of %lu Hz cannot carry a %.0f Hz "
+                       "signal\n",
+               SAMPLE_RATE, JJY_FREQ);
+      return 1;
+    }
+  if (shape != TC_SINE && SAMPLE_RATE <= 6 * JJY_FREQ)
+    {
+      fprintf (stderr, "Warning: A sample rate of %lu Hz cannot carry the "
+                       "third harmonic of a %.0f Hz carrier, playing a sine\n",
+               SAMPLE_RATE, JJY_FREQ);
+    }
+  jjy_populate_edges ();
+  if (ramp > 0)
+    {
+      mod_init ();
+      if (!jjy_populate_envelopes (ramp))
+        {
+          fprintf (stderr, "Warning: Not enough memory to shape keying "
+                           "edges\n");
+        }
+    }
+  if (args.prerender && NCO_STEP != 0)
+    {
+      fprintf (stderr, "Warning: Seconds cannot be prerendered with an NCO, "
+                       "rendering them live\n");
+    }
+  else if (args.prerender && !jjy_populate_seconds ())
+    {
+      fprintf (stderr, "Warning: Not enough memory to prerender seconds, "
+                       "rendering them live\n");
+    }
   err = Pa_Initialize ();
   if (err != paNoError)
     {
       return handle_pa_err (err);
     }
   outputParameters.device = Pa_GetDefaultOutputDevice ();
-  outputParameters.channelCount = 1;
-  outputParameters.sampleFormat = paInt16;
+  outputParameters.channelCount = CHANNELS;
+  outputParameters.sampleFormat = PA_FORMATS[SAMPLE_FORMAT];
   outputParameters.suggestedLatency
       = Pa_GetDeviceInfo (outputParameters.device)->defaultLowOutputLatency;
   outputParameters.hostApiSpecificStreamInfo = NULL;
@@ -744,12 +1044,21 @@ main (int argc, const char *argv[])
   signal (SIGINT, handle_keyboard_interrupt);
   signal (SIGTERM, handle_keyboard_interrupt);
 
-  timespec_get (&now, TIME_UTC);
-  data.seconds = now.tv_sec;
-  data.sample_index = now.tv_nsec * SAMPLE_RATE / MAX_NANOSEC;
+  leap_utc_now (&LEAP_TABLE, &now);
+  data.minute = now.minute;
+  data.second = now.second;
+  data.sample_index = now.nsec * SAMPLE_RATE / MAX_NANOSEC;
   data.wt_index = data.sample_index % WT_SIZE;
-  data.local = get_tm (&now.tv_sec, args.jst);
-  data.high_samples = sec_high_samples (data.local);
+  data.phase = (uint32_t)(NCO_STEP * data.sample_index);
+  jjy_zone_window (args.jst, data.minute, &data.zone[0]);
+  atomic_init (&data.zone_index, 0);
+  data.offset = tc_zone_offset (&data.zone[0], data.minute);
+  jjy_build_fields (&data);
+  data.leap = leap_month_state (&LEAP_TABLE, data.minute);
+  jjy_encode_frame (data.bcd, data.leap,
+                    leap_minute_length (&LEAP_TABLE, data.minute),
+                    &data.frame);
+  jjy_next_second (&data);
   err = Pa_StartStream (STREAM);
   if (err != paNoError)
     {
@@ -758,6 +1067,7 @@ main (int argc, const char *argv[])
   while (Pa_IsStreamActive (STREAM))
     {
       Pa_Sleep (500);
+      jjy_refresh_zone (&data);
     }
   err = Pa_CloseStream (STREAM);
   if (err != paNoError)
@@ -13,11 +13,21 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <https://www.gnu.org/licenses/>. */
 
+#include "dut1.h"
 #include "ersatz-jjy-config.h"
+#include "leapsec.h"
+#include "modulate.h"
+#include "nco.h"
 #include "portaudio.h"
+#include "timecode.h"
+#include "tzif.h"
+#include "wwvbam.h"
+#include "wwvbpm.h"
 #include <math.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,540 +35,259 @@
 
 /* Macro constants */
 #define MAX_NANOSEC (1000000000L)
-#define SAMPLE_RATE (48000)
-#define SAMPLE_SCALE (32767) /* Maximum value of an audio sample */
+#define DEFAULT_RATE (48000)
 #define FRAMES_PER_BUFFER (512)
-#define WWVB_FREQ (20000) /* One-third the actual WWVB longwave frequency */
-#define WT_SIZE (12)
-#define PS_INDEX (6) /* wavetable index phase-shifted 180 degrees */
+#define WWVB_LONGWAVE_FREQ (60000)
+#define PM_SAMPLE (SAMPLE_RATE / 10) /* Where each second's phase is set */
+#define SECOND_KINDS (12) /* AM symbols times starting and PM phases */
+#define LOW_AMPLITUDE (0.02) /* Amplitude of the low signal state */
+#define DST_CAP (16) /* Most DST changes kept for one year */
 
 /* Calculated constants */
-const unsigned long WWVB_B0_LOW_SAMPLES = SAMPLE_RATE / 5;
-const unsigned long WWVB_B1_LOW_SAMPLES = SAMPLE_RATE / 2;
-const unsigned long WWVB_M_LOW_SAMPLES = SAMPLE_RATE * 4 / 5;
-const unsigned long long HALF_HOUR_SEQ_BITS[]
-    = { 0x34bd771e648ab67f, 0xb5037c1610e8c4e5 };
-const unsigned long long FIXED_TIMING_WORD[]
-    = { 0x42a5cb431d9a6b8b, 0x0000009207fb6b47 };
+/* Bit of a WWVB_PM_DST_LS codeword sent in each of seconds 47-52 */
+const unsigned char WWVB_PM_DST_LS_SHIFT[] = { 4, 3, 0, 2, 1, 0 };
+
+/* Global variables determined from CLI flags */
+unsigned long SAMPLE_RATE;
+tc_format SAMPLE_FORMAT;
+int CHANNELS;       /* 2 with --antiphase, otherwise 1 */
+size_t FRAME_BYTES; /* Bytes in one sample of SAMPLE_FORMAT per channel */
+unsigned long WWVB_FREQ; /* The WWVB longwave frequency, or one-third of it */
 
 /* Global PulseAudio stream reference */
 PaStream *STREAM = NULL;
 
+/* PortAudio sample formats, indexed by tc_format */
+const PaSampleFormat PA_FORMATS[] = { paInt16, paInt24, paInt32, paFloat32 };
+
+/* Leap seconds read at startup from a leap-seconds.list file */
+leap_table LEAP_TABLE;
+/* UT1-UTC read at startup from an IERS finals file, if one is given */
+dut1_table DUT1_TABLE;
+tzif_zone LOCAL_ZONE; /* The system time zone, from TZ or /etc/localtime */
+
 /*  Wavetables holding sequential audio samples for high (full amplitude) and
-    low (10% amplitude) signal states. These are populated by
-    populate_wwvb_wavetables() at startup, then samples are repeatedly copied
+    low (LOW_AMPLITUDE) signal states. These are populated by
+    wwvb_populate_wavetables() at startup, then samples are repeatedly copied
     from them directly into the audio buffer. This eliminates the need for
     performing computationally expensive sine calculations while writing to the
     buffer, allowing for smooth sine-wave playback. The size of the wavetables
     is chosen so that it contains a whole number of sine-wave cycles for the
-    given sample rate; for example, 12 samples at a 48kHz sample rate contain
-    exactly 5 cycles of a 20kHz sine-wave; this ensures that consecutive
-    repetitions of the wavetable encode a continuous sine-wave at a constant
-    frequency.
+    given sample rate, as worked out by tc_wavetable_period(); this ensures
+    that consecutive repetitions of the wavetable encode a continuous
+    sine-wave at a constant frequency. Each wavetable is tiled with tc_tile()
+    so that runs of samples can be copied from it with tc_render(). Samples
+    are held in SAMPLE_FORMAT, so they are copied straight into the audio
+    buffer without conversion.
+
+    Each is indexed by whether the carrier is phase-shifted 180 degrees,
+    which inverts it. The wavetable does not always hold an odd number of
+    cycles (at 44.1kHz it holds 200), so the shift cannot be made by
+    starting half way through it instead.
 */
-int16_t WT_HIGH[WT_SIZE];
-int16_t WT_LOW[WT_SIZE];
+unsigned long WT_SIZE;
+void *WT_HIGH[2];
+void *WT_LOW[2];
+
+/*  With --nco or --trim, or when the wavetables would be longer than
+    TC_WAVETABLE_CAP, the carrier is played by a numerically controlled
+    oscillator instead, stepping its phase by NCO_STEP each sample through
+    quarter-wave tables indexed the same way as the wavetables. NCO_STEP is
+    0 if the wavetables are used.
+*/
+uint32_t NCO_STEP = 0;
+nco_table NCO_HIGH[2];
+nco_table NCO_LOW[2];
+
+/* Number of low samples at the start of a second, indexed by tc_symbol */
+unsigned long WWVB_SYMBOL_LOW_SAMPLES[3];
+
+/*  With --prerender, every kind of second is rendered once at startup by
+    wwvb_populate_seconds(): each AM symbol, starting in either phase and
+    switching to either phase at PM_SAMPLE. The callback then plays whole
+    seconds with a single copy, at the cost of SECOND_KINDS seconds of
+    samples (about 1.1MB at the default rate and format). NULL if seconds are
+    rendered live.
+*/
+unsigned char *WWVB_SECONDS = NULL;
+
+/*  With --ramp, the amplitude edges are shaped with raised-cosine ramps
+    rather than switching between WT_HIGH and WT_LOW: the carrier in WT_HIGH
+    is multiplied by an envelope, one second of which is rendered by
+    wwvb_populate_envelopes() for each AM symbol (about 288KB at the default
+    rate). NULL if the edges are not shaped.
+*/
+int16_t *WWVB_ENVELOPES = NULL;
 
 typedef struct
 {
+  bool antiphase;
+  bool direct;
   bool help;
+  bool nco;
+  bool prerender;
+  bool stats;
   bool version;
+  const char *dut1_file;
+  const char *format;
+  const char *leap_file;
+  const char *ramp;
+  const char *rate;
+  const char *trim;
+  const char *utc_offset;
+  const char *wave;
+  const char *zone;
 } wwvb_args;
 
 typedef struct
 {
   char short_form;
   char *long_form;
+  char *metavar; /* Name of the flag's argument, or NULL if it takes none */
   char *help_text;
-  void (*setter) (wwvb_args *);
+  void (*setter) (wwvb_args *, const char *);
 } wwvb_cli_flag;
 
+/* Everything the audio callback needs to play one minute */
 typedef struct
 {
-  time_t seconds;
-  unsigned long sample_index;
-  unsigned long wt_index;
-  unsigned long low_samples;
-} wwvb_data;
-
-/* Functions that calculate individual bits of the WWVB AM time code */
-
-bool
-wwvb_b01 (const time_t *t)
-{
-  return (gmtime (t)->tm_min >= 40);
-}
-
-bool
-wwvb_b02 (const time_t *t)
-{
-  return ((gmtime (t)->tm_min % 40) >= 20);
-}
-
-bool
-wwvb_b03 (const time_t *t)
-{
-  return ((gmtime (t)->tm_min % 20) >= 10);
-}
-
-bool
-wwvb_b05 (const time_t *t)
-{
-  return ((gmtime (t)->tm_min % 10) >= 8);
-}
-
-bool
-wwvb_b06 (const time_t *t)
-{
-  return (((gmtime (t)->tm_min % 10) % 8) >= 4);
-}
-
-bool
-wwvb_b07 (const time_t *t)
-{
-  return (((gmtime (t)->tm_min % 10) % 4) >= 2);
-}
-
-bool
-wwvb_b08 (const time_t *t)
-{
-  return ((gmtime (t)->tm_min % 2) > 0);
-}
-
-bool
-wwvb_b12 (const time_t *t)
-{
-  return (gmtime (t)->tm_hour >= 20);
-}
-
-bool
-wwvb_b13 (const time_t *t)
-{
-  return ((gmtime (t)->tm_hour % 20) >= 10);
-}
-
-bool
-wwvb_b15 (const time_t *t)
-{
-  return ((gmtime (t)->tm_hour % 10) >= 8);
-}
-
-bool
-wwvb_b16 (const time_t *t)
-{
-  return (((gmtime (t)->tm_hour % 10) % 8) >= 4);
-}
-
-bool
-wwvb_b17 (const time_t *t)
-{
-  return (((gmtime (t)->tm_hour % 10) % 4) >= 2);
-}
-
-bool
-wwvb_b18 (const time_t *t)
-{
-  return ((gmtime (t)->tm_hour % 2) > 0);
-}
-
-bool
-wwvb_b22 (const time_t *t)
-{
-  return ((gmtime (t)->tm_yday + 1) >= 200);
-}
-
-bool
-wwvb_b23 (const time_t *t)
-{
-  return (((gmtime (t)->tm_yday + 1) % 200) >= 100);
-}
-
-bool
-wwvb_b25 (const time_t *t)
-{
-  return (((gmtime (t)->tm_yday + 1) % 100) >= 80);
-}
-
-bool
-wwvb_b26 (const time_t *t)
-{
-  return ((((gmtime (t)->tm_yday + 1) % 100) % 80) >= 40);
-}
-
-bool
-wwvb_b27 (const time_t *t)
-{
-  return ((((gmtime (t)->tm_yday + 1) % 100) % 40) >= 20);
-}
-
-bool
-wwvb_b28 (const time_t *t)
-{
-  return (((gmtime (t)->tm_yday + 1) % 20) >= 10);
-}
-
-bool
-wwvb_b30 (const time_t *t)
-{
-  return (((gmtime (t)->tm_yday + 1) % 10) >= 8);
-}
-
-bool
-wwvb_b31 (const time_t *t)
-{
-  return ((((gmtime (t)->tm_yday + 1) % 10) % 8) >= 4);
-}
-
-bool
-wwvb_b32 (const time_t *t)
-{
-  return ((((gmtime (t)->tm_yday + 1) % 10) % 4) >= 2);
-}
-
-bool
-wwvb_b33 (const time_t *t)
-{
-  return (((gmtime (t)->tm_yday + 1) % 2) > 0);
-}
+  tc_frame frame; /* AM symbols */
+  uint64_t pm;    /* Bit n is set if second n is sent phase-shifted */
+} wwvb_minute;
 
-/* Bits 36-38 and 40-43 of the WWVB time code provide DUT1 information. The C
-   standard libraries provide no information about DUT1, so this code assumes
-   a constant DUT1 value of +0.0s, and expects that a receiving device will
-   ignore the DUT1 value.
+/*  The DST changes of the local time zone during one year of the encoded
+    time, found when the year starts, so that the DST bits of each day are a
+    table lookup.
 */
-
-bool
-wwvb_b36 (const time_t *t)
-{
-  return true;
-}
-
-bool
-wwvb_b37 (const time_t *t)
-{
-  return false;
-}
-
-bool
-wwvb_b38 (const time_t *t)
-{
-  return true;
-}
-
-bool
-wwvb_b40 (const time_t *t)
-{
-  return false;
-}
-
-bool
-wwvb_b41 (const time_t *t)
-{
-  return false;
-}
-
-bool
-wwvb_b42 (const time_t *t)
-{
-  return false;
-}
-
-bool
-wwvb_b43 (const time_t *t)
-{
-  return false;
-}
-
-bool
-wwvb_b45 (const time_t *t)
-{
-  return ((gmtime (t)->tm_year % 100) >= 80);
-}
-
-bool
-wwvb_b46 (const time_t *t)
-{
-  return (((gmtime (t)->tm_year % 100) % 80) >= 40);
-}
-
-bool
-wwvb_b47 (const time_t *t)
-{
-  return (((gmtime (t)->tm_year % 100) % 40) >= 20);
-}
-
-bool
-wwvb_b48 (const time_t *t)
-{
-  return ((gmtime (t)->tm_year % 20) >= 10);
-}
-
-bool
-wwvb_b50 (const time_t *t)
-{
-  return ((gmtime (t)->tm_year % 10) >= 8);
-}
-
-bool
-wwvb_b51 (const time_t *t)
-{
-  return (((gmtime (t)->tm_year % 10) % 8) >= 4);
-}
-
-bool
-wwvb_b52 (const time_t *t)
-{
-  return (((gmtime (t)->tm_year % 10) % 4) >= 2);
-}
-
-bool
-wwvb_b53 (const time_t *t)
-{
-  return ((gmtime (t)->tm_year % 2) > 0);
-}
-
-bool
-wwvb_b55 (const time_t *t)
+typedef struct
 {
-  const unsigned int year = gmtime (t)->tm_year + 1900;
+  long year;  /* Encoded year covered, or -1 before the first is found */
+  bool isdst; /* DST state at the start of the year */
+  int count;
+  time_t change[DST_CAP]; /* Times the DST state flips, in order */
+} wwvb_dst_year;
 
-  return (year % 4 == 0) && ((year % 100 == 0) == (year % 400 == 0));
-}
-
-bool
-wwvb_b56 (const time_t *t)
+typedef struct
 {
-  /*  Bit 56 should indicate whether the current UTC month ends with a
-      (positive) leap second, but the system time used by C standard libraries
-      does not capture leap seconds in many implementations, so here we always
-      assume no upcoming leap second.
+  time_t minute;   /* POSIX time at the start of the last minute built */
+  long offset;     /* Seconds added to UTC in the encoded time */
+  struct tm coded; /* Encoded calendar time of minute, with tm_sec of 0 */
+  unsigned int bcd[TC_FIELD_COUNT]; /* Calendar fields encoded in frame */
+  uint64_t flags; /* AM bits 36-43 and 55-58, which change once a day */
+  /* AM bits 57 and 58 as a two-bit number, as read by the PM code */
+  unsigned int dst;
+  wwvb_dst_year dst_year;
+  /*  PM code of the extended mode frame starting at extended_start, one
+      word per minute with bit n for second n, or -1 if none is built yet.
   */
-  return false;
-}
+  uint64_t extended[WWVB_EXT_MINUTES];
+  time_t extended_start;
+  /* minute_of_century() of coded, for the PM time code */
+  unsigned long mins;
+  leap_kind leap; /* Leap second at the end of the current UTC month */
+  /*  The minute being played and the one after it. The main thread builds
+      the next minute into the slot not being played and sets next_ready;
+      the callback switches slots at the end of the minute and clears it, so
+      it never does any calendar work itself.
+  */
+  wwvb_minute minutes[2];
+  int playing; /* Index into minutes, only changed by the callback */
+  atomic_bool next_ready;
+  /*  Frames the callback has started since the first, and the frame the
+      minute built last is for, which the callback checks before switching
+      to it
+  */
+  atomic_ulong frame;
+  unsigned long next_frame;
+  int second; /* Index of the current second within the minute played */
+  unsigned long sample_index;
+  unsigned long wt_index;
+  uint32_t phase; /* Carrier phase with the NCO engine */
+  unsigned long low_samples;
+  bool shifted; /* Whether the carrier is currently phase-shifted */
+  const unsigned char *wave; /* Prerendered current second, or NULL */
+  const int16_t *envelope; /* Envelope of the current second, or NULL */
+} wwvb_data;
 
-bool
-wwvb_b57 (const time_t *t)
+time_t
+utc_day_start (time_t t)
 {
-  time_t local_offset;
-  struct tm *utc_now;
-  struct tm eod_utc;
-  time_t eod_local;
-
-  utc_now = gmtime (t);
-  local_offset = *t - mktime (utc_now);
-  eod_utc.tm_year = utc_now->tm_year, eod_utc.tm_mon = utc_now->tm_mon,
-  eod_utc.tm_mday = utc_now->tm_mday, eod_utc.tm_hour = 23,
-  eod_utc.tm_min = 59, eod_utc.tm_sec = 59, eod_utc.tm_wday = utc_now->tm_wday,
-  eod_utc.tm_yday = utc_now->tm_yday, eod_utc.tm_isdst = 0;
-  eod_local = mktime (&eod_utc) + local_offset;
-  return localtime (&eod_local)->tm_isdst;
-}
+  /* Return the start of the UTC day containing t */
+  time_t secs = t % TC_SECONDS_PER_DAY;
 
-bool
-wwvb_b58 (const time_t *t)
-{
-  time_t local_offset;
-  struct tm *utc_now;
-  struct tm bod_utc;
-  time_t bod_local;
-
-  utc_now = gmtime (t);
-  local_offset = *t - mktime (utc_now);
-  bod_utc.tm_year = utc_now->tm_year;
-  bod_utc.tm_mon = utc_now->tm_mon;
-  bod_utc.tm_mday = utc_now->tm_mday;
-  bod_utc.tm_hour = 0;
-  bod_utc.tm_min = 0;
-  bod_utc.tm_sec = 0;
-  bod_utc.tm_wday = utc_now->tm_wday;
-  bod_utc.tm_yday = utc_now->tm_yday;
-  bod_utc.tm_isdst = 0;
-  bod_local = mktime (&bod_utc) + local_offset;
-  return localtime (&bod_local)->tm_isdst;
+  return t - ((secs < 0) ? secs + TC_SECONDS_PER_DAY : secs);
 }
 
-unsigned long
-minute_of_century (const struct tm *t)
+void
+wwvb_find_dst_year (wwvb_dst_year *y, long year, long offset)
 {
-  int year;
-  int first_year;
-  unsigned long total_minutes;
-  int i;
-  const unsigned int minutes_per_day = 1440;
-
-  total_minutes = 0;
-  year = t->tm_year + 1900;
-  first_year = year - (year % 100);
-  for (i = first_year; i < year; i++)
+  /*  Fill in the DST changes of the local zone during the given year of the
+      encoded time, which is UTC plus offset. Changes of UTC offset alone,
+      with no change of DST state, are left out.
+  */
+  const time_t start
+      = tc_days_from_civil (year, 1, 1) * TC_SECONDS_PER_DAY - offset;
+  const time_t end
+      = tc_days_from_civil (year + 1, 1, 1) * TC_SECONDS_PER_DAY - offset;
+  tc_zone_window w;
+  bool isdst;
+
+  tzif_window (&LOCAL_ZONE, start, &w);
+  y->year = year;
+  y->isdst = w.isdst;
+  y->count = 0;
+  isdst = w.isdst;
+  while (w.change < end && y->count < DST_CAP)
     {
-      if ((i % 4 == 0) && ((i % 100 == 0) == (i % 400 == 0)))
-        {
-          total_minutes += (366 * minutes_per_day);
-        }
-      else
+      if (w.next_isdst != isdst)
         {
-          total_minutes += (365 * minutes_per_day);
+          y->change[y->count++] = w.change;
+          isdst = w.next_isdst;
         }
+      tzif_window (&LOCAL_ZONE, w.change, &w);
     }
-  total_minutes += (t->tm_yday * minutes_per_day);
-  total_minutes += (t->tm_hour * 60);
-  total_minutes += t->tm_min;
-  return total_minutes;
 }
 
 bool
-wwvb_pm_time (const struct tm *t, const unsigned long *mins)
+wwvb_dst_at (const wwvb_dst_year *y, time_t t)
 {
+  /* Whether DST is in effect at t, which must be in y's year */
+  bool isdst = y->isdst;
   int i;
 
-  if (t->tm_sec >= 40)
-    {
-      i = 46 - t->tm_sec;
-    }
-  else if (t->tm_sec >= 30)
-    {
-      i = 45 - t->tm_sec;
-    }
-  else if (t->tm_sec >= 20)
-    {
-      i = 44 - t->tm_sec;
-    }
-  else if (t->tm_sec == 19)
+  for (i = 0; i < y->count && y->change[i] <= t; i++)
     {
-      i = 0;
+      isdst = !isdst;
     }
-  else
-    {
-      /* Only remaining case should be second 18 */
-      i = 25;
-    }
-  return (*mins & (1 << i)) != 0;
+  return isdst;
 }
 
 bool
-wwvb_pm_ecc (const struct tm *t, const unsigned long *mins)
+wwvb_b57 (const wwvb_dst_year *y, time_t day)
 {
-  /* Odd-parity Hamming code over the 26 time code bits except bit 0 */
-  int p;
-  int i;
-  bool b;
-  struct tm data_bit_tm;
-
-  p = 17 - t->tm_sec;
-  b = true;
-  data_bit_tm = *t;
-  for (i = 1; i < 26; i++)
-    {
-      if (!((1 << p) & i))
-        {
-          continue;
-        }
-      if (i <= 6)
-        {
-          data_bit_tm.tm_sec = 46 - i;
-        }
-      else if (i <= 15)
-        {
-          data_bit_tm.tm_sec = 45 - i;
-        }
-      else if (i <= 24)
-        {
-          data_bit_tm.tm_sec = 44 - i;
-        }
-      else
-        {
-          data_bit_tm.tm_sec = 18;
-        }
-      b = (b != wwvb_pm_time (&data_bit_tm, mins));
-    }
-  return b;
+  /* DST is in effect in the local zone at the end of the encoded day */
+  return wwvb_dst_at (y, day + TC_SECONDS_PER_DAY - 1);
 }
 
 bool
-access_bit (const unsigned long long a[], int index)
+wwvb_b58 (const wwvb_dst_year *y, time_t day)
 {
-  return ((1 << (index % 64)) & a[index / 64]) != 0;
-}
-
-int
-half_hour_seq (const struct tm *t, bool dst_eod, bool dst_bod)
-{
-  if (!(dst_eod || dst_bod))
-    {
-      return (t->tm_hour * 4) + (t->tm_min / 17) + 1;
-    }
-  else if (dst_eod && dst_bod)
-    {
-      return (t->tm_hour * 4) + (t->tm_min / 17) + 2;
-    }
-  else if (dst_eod && !dst_bod)
-    {
-      if (t->tm_hour <= 3)
-        {
-          return (t->tm_hour * 4) + (t->tm_min / 17) + 1;
-        }
-      else if (t->tm_hour <= 10)
-        {
-          return (t->tm_hour * 4) + (t->tm_min / 17) + 81;
-        }
-      else /* t->tm_hour > 10 */
-        {
-          return (t->tm_hour * 4) + (t->tm_min / 17) + 2;
-        }
-    }
-  else /* !dst_eod && dst_bod */
-    {
-      if (t->tm_hour <= 3)
-        {
-          return (t->tm_hour * 4) + (t->tm_min / 17) + 2;
-        }
-      else if (t->tm_hour <= 10)
-        {
-          return (t->tm_hour * 4) + (t->tm_min / 17) + 82;
-        }
-      else /* t->tm_hour > 10 */
-        {
-          return (t->tm_hour * 4) + (t->tm_min / 17) + 1;
-        }
-    }
+  /* DST is in effect in the local zone at the start of the encoded day */
+  return wwvb_dst_at (y, day);
 }
 
 bool
-wwvb_pm_six_min (const time_t *t)
+wwvb_pm (const wwvb_data *d, int second)
 {
-  int frame_sec;
-  int seq;
-  struct tm *now;
-
-  now = gmtime (t);
-  frame_sec = ((now->tm_min % 10) * 60) + now->tm_sec;
-  if (frame_sec < 127)
-    {
-      seq = half_hour_seq (now, wwvb_b57 (t), wwvb_b58 (t));
-      return access_bit (HALF_HOUR_SEQ_BITS, (seq - 1 + frame_sec) % 127);
-    }
-  else if (frame_sec < 233)
-    {
-      return access_bit (FIXED_TIMING_WORD, frame_sec - 127);
-    }
-  else /* frame_sec >= 233 */
-    {
-      seq = half_hour_seq (now, wwvb_b57 (t), wwvb_b58 (t));
-      return access_bit (HALF_HOUR_SEQ_BITS, (seq + 358 - frame_sec) % 127);
-    }
-}
-
-bool
-wwvb_pm (const time_t *t)
-{
-  struct tm *now;
-  unsigned long mins;
+  /*  Phase modulation bit for second of the current minute, from the
+      minute's broken-down UTC time and cached DST state, so that no
+      calendar or time zone lookups are needed from the audio callback.
+  */
+  struct tm now_tm = d->coded;
+  const struct tm *now = &now_tm;
+  int shift;
 
-  now = gmtime (t);
-  if (((now->tm_min % 30 >= 10) && now->tm_min % 30 <= 16))
-    {
-      return wwvb_pm_six_min (t);
-    }
+  now_tm.tm_sec = second;
   switch (now->tm_sec)
     {
     case 0:
@@ -586,8 +315,7 @@ wwvb_pm (const time_t *t)
     case 15:
     case 16:
     case 17:
-      mins = minute_of_century (now);
-      return wwvb_pm_ecc (now, &mins);
+      return wwvb_pm_ecc (now, &d->mins);
     case 18:
     case 19:
     case 20:
@@ -615,22 +343,17 @@ wwvb_pm (const time_t *t)
     case 44:
     case 45:
     case 46:
-      mins = minute_of_century (now);
-      return wwvb_pm_time (now, &mins);
+      return wwvb_pm_time (now, &d->mins);
     /*  Phase modulation code bits 47-52, excluding bit 49, encode leap second
-        information together with DST status and error correction. This
-        implementation is simplified because it assumes no upcoming leap
-        second.
+        information together with DST status and error correction.
     */
     case 47:
-    case 50:
-      return wwvb_b57 (t) != wwvb_b58 (t);
     case 48:
-      return !(wwvb_b57 (t) || wwvb_b58 (t));
+    case 50:
     case 51:
-      return wwvb_b57 (t);
     case 52:
-      return wwvb_b58 (t);
+      shift = WWVB_PM_DST_LS_SHIFT[now->tm_sec - 47];
+      return (wwvb_pm_dst_ls (d->dst, d->leap) >> shift) & 1;
     /*  Bits 53-59 of the phase modulation code denote the DST rules in effect
         for the U.S. For simplicity, this implementation assumes that
         established rules remain in effect: DST begins at 2:00 AM local time
@@ -654,125 +377,145 @@ wwvb_pm (const time_t *t)
     }
 }
 
-unsigned long
-sec_low_samples (const time_t *t)
+void
+wwvb_update_leap (wwvb_data *d)
 {
-  struct tm *utc = gmtime (t);
-  /*  Return the number of high (full amplitude) samples that should be played
-      at the start of the second represented by t. The length of the high
-      signal at the start of each second represents either a 0 bit, a 1 bit,
-      or a marker that allows the receiver to recognize the structure of the
-      time code and where the encoded minute begins and ends.
-
-      In the real JJY time code, minutes 15 and 45 of every hour follow an
-      altered format where bits 41-48 are replaced by a Morse code station
-      identifier and bits 50 through 55 are replaced by bits providing
-      information about upcoming planned service interruptions. This program
-      does not replicate this behavior and instead follows the same format
-      for all other minutes of the hour during minutes 15 and 45, expecting
-      the receiver to ignore information in the affected time-frames.
+  /*  The leap second warning changes at the start of a UTC month, which is
+      only the start of an encoded day if there is no offset, so it is
+      looked up every minute.
   */
+  d->leap = leap_month_state (&LEAP_TABLE, d->minute);
+  d->flags = (d->flags & ~WWVB_LEAP_FLAG) | wwvb_leap_flags (d->leap);
+}
 
-  /*  Lookup table for functions that determine bit value for each second;
-      a null pointer is provided for seconds that encode markers or a constant
-      value of zero.
+void
+wwvb_rebuild_fields (wwvb_data *d)
+{
+  /*  Recompute the calendar fields and daily flags for d->minute. This is
+      the only place the encoder breaks down a time, which happens once per
+      encoded day, or looks up the time zone, which happens once per encoded
+      year. The encoded time is UTC shifted by d->offset, and the day whose
+      DST state bits 57 and 58 describe is shifted along with it.
   */
-  bool (*wwvb_bit_func[]) (const time_t *) = {
-    NULL,     wwvb_b01, wwvb_b02, wwvb_b03, NULL,     wwvb_b05, wwvb_b06,
-    wwvb_b07, wwvb_b08, NULL,     NULL,     NULL,     wwvb_b12, wwvb_b13,
-    NULL,     wwvb_b15, wwvb_b16, wwvb_b17, wwvb_b18, NULL,     NULL,
-    NULL,     wwvb_b22, wwvb_b23, NULL,     wwvb_b25, wwvb_b26, wwvb_b27,
-    wwvb_b28, NULL,     wwvb_b30, wwvb_b31, wwvb_b32, wwvb_b33, NULL,
-    NULL,     wwvb_b36, wwvb_b37, wwvb_b38, NULL,     wwvb_b40, wwvb_b41,
-    wwvb_b42, wwvb_b43, NULL,     wwvb_b45, wwvb_b46, wwvb_b47, wwvb_b48,
-    NULL,     wwvb_b50, wwvb_b51, wwvb_b52, wwvb_b53, NULL,     wwvb_b55,
-    wwvb_b56, wwvb_b57, wwvb_b58, NULL,     NULL /* Second 60, a leap second */
-  };
-
-  switch (utc->tm_sec)
+  const time_t coded = d->minute + d->offset;
+  const time_t day = utc_day_start (coded) - d->offset;
+
+  tc_breakdown (coded, &d->coded);
+  tc_bcd_fields (&d->coded, d->bcd);
+  d->mins = minute_of_century (&d->coded);
+  if (d->dst_year.year != d->coded.tm_year + 1900L)
     {
-    /*  This code does not correctly implement leap seconds; if a minute
-        ends in a positive leap second, then second 59 should encode a value
-        of 0, instead of a marker as it does during any other minute.
-        Conversely, if a minute ends with a negative leap second, then
-        second 58 should encode a marker instead of its usual value of 0.
-        Although the C11 standard allows a minute with 61 seconds according
-        to the struct tm type, the underlying implementation of the time_t
-        type that canonically represents a datetime is often incapable of
-        representing leap seconds.
-    */
-    case 0:
-    case 9:
-    case 19:
-    case 29:
-    case 39:
-    case 49:
-    case 59:
-    case 60: /* Leap second */
-      /* These seconds of the 60-second time code encode markers */
-      return WWVB_M_LOW_SAMPLES;
-    case 4:
-    case 10:
-    case 11:
-    case 14:
-    case 20:
-    case 21:
-    case 24:
-    case 34:
-    case 35:
-    case 44:
-    case 54:
-      /* These seconds of the 60-second time code always encode 0 */
-      return WWVB_B0_LOW_SAMPLES;
-    case 1:
-    case 2:
-    case 3:
-    case 5:
-    case 6:
-    case 7:
-    case 8:
-    case 12:
-    case 13:
-    case 15:
-    case 16:
-    case 17:
-    case 18:
-    case 22:
-    case 23:
-    case 25:
-    case 26:
-    case 27:
-    case 28:
-    case 30:
-    case 31:
-    case 32:
-    case 33:
-    case 36:
-    case 37:
-    case 38:
-    case 40:
-    case 41:
-    case 42:
-    case 43:
-    case 45:
-    case 46:
-    case 47:
-    case 48:
-    case 50:
-    case 51:
-    case 52:
-    case 53:
-    case 55:
-    case 56:
-    case 57:
-    case 58:
-      /* These seconds encode variable bits with time information */
-      return (wwvb_bit_func[utc->tm_sec](t) ? WWVB_B1_LOW_SAMPLES
-                                            : WWVB_B0_LOW_SAMPLES);
-    default:
-      /* In practice, this block should be unreachable */
-      return WWVB_B0_LOW_SAMPLES;
+      wwvb_find_dst_year (&d->dst_year, d->coded.tm_year + 1900L,
+                          d->offset);
+    }
+  d->dst = (wwvb_b57 (&d->dst_year, day) << 1) | wwvb_b58 (&d->dst_year, day);
+  /*  DUT1 changes at UTC midnight, which is only the start of an encoded
+      day if there is no offset. It changes by a tenth of a second every few
+      weeks at most, so the value for the start of the encoded day is used
+      all day.
+  */
+  d->flags = wwvb_dut1_bits (dut1_tenths (&DUT1_TABLE, day))
+             | ((uint64_t)wwvb_b55 (&d->coded) << 55)
+             | ((uint64_t)(d->dst >> 1) << 57) | ((uint64_t)(d->dst & 1) << 58);
+  wwvb_update_leap (d);
+}
+
+uint64_t
+wwvb_encode_pm (wwvb_data *d)
+{
+  /*  Return the phase modulation bits of every second of d->minute. A leap
+      second keeps the reference phase, like a marker, so bit 60 is never
+      set. The extended mode frame is built once, on its first minute, and
+      its later minutes are taken from it.
+  */
+  const int ext_minute = d->coded.tm_min % 30 - WWVB_EXT_FIRST;
+  uint64_t pm = 0;
+  int sec;
+
+  if (wwvb_in_extended (&d->coded))
+    {
+      if (d->extended_start != d->minute - ext_minute * 60)
+        {
+          wwvb_build_extended (&d->coded, d->dst, d->extended);
+          d->extended_start = d->minute - ext_minute * 60;
+        }
+      return d->extended[ext_minute];
+    }
+  for (sec = 0; sec < TC_FRAME_SECONDS; sec++)
+    {
+      pm |= (uint64_t)wwvb_pm (d, sec) << sec;
+    }
+  return pm;
+}
+
+void
+wwvb_build_minute (wwvb_data *d, wwvb_minute *m)
+{
+  /* Encode the AM and PM codes of d->minute into m */
+  wwvb_encode_frame (d->bcd, d->flags,
+                     leap_minute_length (&LEAP_TABLE, d->minute), &m->frame);
+  m->pm = wwvb_encode_pm (d);
+}
+
+void
+wwvb_next_frame (wwvb_data *d)
+{
+  /*  Move the fields on to the minute starting at d->minute. The encoded
+      time is UTC plus a fixed offset, so within a day consecutive minutes
+      differ only by a BCD increment of the minute and hour fields, and the
+      previous minute's fields and broken-down time are advanced in place.
+      The remaining fields and the leap year and DST flags can only change
+      at midnight, where everything is rebuilt from the calendar instead.
+      Like d->minute, this follows the sample clock alone: the system clock
+      is only read at startup, so a later step of it is not followed.
+  */
+  if (!tc_advance_minute (d->bcd))
+    {
+      wwvb_rebuild_fields (d);
+      return;
     }
+  d->mins += 1;
+  if (++d->coded.tm_min == 60)
+    {
+      d->coded.tm_min = 0;
+      d->coded.tm_hour += 1;
+    }
+  wwvb_update_leap (d);
+}
+
+void
+wwvb_prepare_next (wwvb_data *d)
+{
+  /*  Called periodically from the main thread. Once the callback has moved
+      on to the minute prepared last time, build the one after it in the
+      free slot and publish it. This leaves nearly a whole minute to do so.
+      If the callback had to repeat minutes because none was ready in time,
+      skip the ones it missed and rebuild the fields from the calendar, so
+      the broadcast does not fall behind. Here we assume that the time_t
+      type encodes the time as a number of seconds since an arbitrary point
+      in time. Technically this is not specified in the C standard but this
+      is how it is typically implemented in practice.
+  */
+  unsigned long frame;
+
+  if (atomic_load_explicit (&d->next_ready, memory_order_acquire))
+    {
+      return;
+    }
+  frame = atomic_load_explicit (&d->frame, memory_order_acquire) + 1;
+  if (frame == d->next_frame + 1)
+    {
+      d->minute += 60;
+      wwvb_next_frame (d);
+    }
+  else
+    {
+      d->minute += 60 * (time_t)(frame - d->next_frame);
+      wwvb_rebuild_fields (d);
+    }
+  d->next_frame = frame;
+  wwvb_build_minute (d, &d->minutes[1 - d->playing]);
+  atomic_store_explicit (&d->next_ready, true, memory_order_release);
 }
 
 int
@@ -784,86 +527,473 @@ handle_pa_err (PaError err)
   return err;
 }
 
+unsigned char *
+wwvb_second_wave (tc_symbol sym, bool start_shifted, bool shifted)
+{
+  /*  Prerendered second for the given AM symbol, starting phase and phase
+      from PM_SAMPLE on, within WWVB_SECONDS
+  */
+  return &WWVB_SECONDS[((sym * 2 + start_shifted) * 2 + shifted)
+                       * SAMPLE_RATE * FRAME_BYTES];
+}
+
 static int
 wwvb_stream_callback (const void *inputBuffer, void *outputBuffer,
                       unsigned long framesPerBuffer,
                       const PaStreamCallbackTimeInfo *timeInfo,
                       PaStreamCallbackFlags statusFlags, void *userData)
 {
-  int16_t *out = (int16_t *)outputBuffer;
-  unsigned long i;
+  unsigned char *out = outputBuffer;
+  unsigned long i = 0;
+  unsigned long n;
+  unsigned long end;
+  unsigned long frame;
+  tc_symbol sym;
   wwvb_data *d = (wwvb_data *)userData;
+  const wwvb_minute *m = &d->minutes[d->playing];
 
-  for (i = 0; i < framesPerBuffer; i++)
+  /*  The buffer is filled one segment at a time. Each second has three: the
+      low amplitude before the phase is set at PM_SAMPLE, the rest of the low
+      amplitude, and the high amplitude, so the boundaries between them only
+      have to be checked once per segment rather than once per sample.
+  */
+  while (i < framesPerBuffer)
     {
-      if (d->sample_index == (SAMPLE_RATE / 10))
+      if (d->sample_index == PM_SAMPLE)
+        {
+          d->shifted = (m->pm >> d->second) & 1;
+        }
+      /*  Prerendered seconds are still split at PM_SAMPLE, so that shifted
+          follows the phase the next second starts in.
+      */
+      end = (d->sample_index < PM_SAMPLE) ? PM_SAMPLE
+            : (d->wave == NULL && d->envelope == NULL
+               && d->sample_index < d->low_samples)
+                ? d->low_samples
+                : SAMPLE_RATE;
+      n = end - d->sample_index;
+      if (n > framesPerBuffer - i)
+        {
+          n = framesPerBuffer - i;
+        }
+      if (d->wave != NULL)
         {
-          d->wt_index = wwvb_pm (&d->seconds) ? PS_INDEX : 0;
+          memcpy (&out[i * FRAME_BYTES],
+                  &d->wave[d->sample_index * FRAME_BYTES], n * FRAME_BYTES);
+          d->wt_index = (d->wt_index + n) % WT_SIZE;
         }
-      if (d->sample_index < d->low_samples)
+      else if (NCO_STEP != 0)
         {
-          out[i] = WT_LOW[d->wt_index];
+          d->phase = nco_render (&out[i * FRAME_BYTES], n,
+                                 (d->envelope == NULL
+                                  && d->sample_index < d->low_samples)
+                                     ? &NCO_LOW[d->shifted]
+                                     : &NCO_HIGH[d->shifted],
+                                 d->phase, NCO_STEP, CHANNELS);
+          if (d->envelope != NULL)
+            {
+              mod_apply (&out[i * FRAME_BYTES], &out[i * FRAME_BYTES],
+                         &d->envelope[d->sample_index * CHANNELS],
+                         n * CHANNELS, SAMPLE_FORMAT);
+            }
+        }
+      else if (d->envelope != NULL)
+        {
+          d->wt_index = mod_render (&out[i * FRAME_BYTES], n,
+                                    WT_HIGH[d->shifted], WT_SIZE, d->wt_index,
+                                    &d->envelope[d->sample_index * CHANNELS],
+                                    SAMPLE_FORMAT, CHANNELS);
         }
       else
         {
-          out[i] = WT_HIGH[d->wt_index];
+          d->wt_index = tc_render (&out[i * FRAME_BYTES], n,
+                                   (d->sample_index < d->low_samples)
+                                       ? WT_LOW[d->shifted]
+                                       : WT_HIGH[d->shifted],
+                                   WT_SIZE, d->wt_index, FRAME_BYTES);
         }
-      d->wt_index = (d->wt_index + 1) % WT_SIZE;
-      d->sample_index += 1;
+      i += n;
+      d->sample_index += n;
       if (d->sample_index >= SAMPLE_RATE)
         {
-          /*  Move on to the next second. Here we assume that the time_t type
-              encodes the time as a number of seconds since an arbitrary point
-              in time. Technically this is not specified in the C standard but
-              this is how it is typically implemented in practice.
+          /*  Move on to the next second, and on to the next minute once
+              every second of the frame has been played, including any leap
+              second.
           */
-          d->seconds += 1;
           d->sample_index = 0;
-          d->low_samples = sec_low_samples (&d->seconds);
+          d->second += 1;
+          if (d->second >= m->frame.length)
+            {
+              /*  If the main thread has not managed to prepare the next
+                  minute in time, repeat this one rather than wait for it. A
+                  minute prepared for a frame that has already started is
+                  dropped, and the main thread then builds the one after
+                  the current frame instead.
+              */
+              frame = atomic_load_explicit (&d->frame, memory_order_relaxed)
+                      + 1;
+              atomic_store_explicit (&d->frame, frame, memory_order_release);
+              if (atomic_load_explicit (&d->next_ready, memory_order_acquire))
+                {
+                  if (d->next_frame == frame)
+                    {
+                      d->playing = 1 - d->playing;
+                      m = &d->minutes[d->playing];
+                    }
+                  atomic_store_explicit (&d->next_ready, false,
+                                         memory_order_release);
+                }
+              d->second = 0;
+            }
+          sym = tc_frame_symbol (&m->frame, d->second);
+          d->low_samples = WWVB_SYMBOL_LOW_SAMPLES[sym];
+          d->envelope = (WWVB_ENVELOPES != NULL)
+                            ? &WWVB_ENVELOPES[sym * SAMPLE_RATE * CHANNELS]
+                            : NULL;
+          /*  A second is a whole number of wavetables, so every second
+              starts at the start of one, in the phase the previous second
+              left the carrier in.
+          */
+          d->wave = (WWVB_SECONDS != NULL)
+                        ? wwvb_second_wave (sym, d->shifted,
+                                            (m->pm >> d->second) & 1)
+                        : NULL;
         }
     }
   return paContinue;
 }
 
-void
-wwvb_populate_wavetables (int16_t WT_HIGH[WT_SIZE], int16_t WT_LOW[WT_SIZE])
+bool
+wwvb_open_local_zone (const char *name)
+{
+  /*  Read the time zone called name, or if name is NULL the system time
+      zone, the way the C library would. Without a system time zone, fall
+      back to UTC, which is also what the C library does.
+  */
+  if (name != NULL)
+    {
+      return tzif_open (&LOCAL_ZONE, name);
+    }
+  if (!tzif_open (&LOCAL_ZONE, NULL))
+    {
+      fprintf (stderr, "Warning: Could not read the local time zone, using "
+                       "UTC\n");
+      tzif_open (&LOCAL_ZONE, "UTC0");
+    }
+  return true;
+}
+
+bool
+wwvb_populate_wavetables (bool nco, double trim, tc_shape shape)
 {
-  const double PI = acos (-1);
+  /*  Allocate the wavetables in the given waveshape, and fill in
+      WWVB_SYMBOL_LOW_SAMPLES, for SAMPLE_RATE. The NCO is set up instead if
+      nco is set, the carrier is trimmed by trim parts per million, or the
+      wavetables would be too long. Returns false if there is not enough
+      memory.
+  */
   const double cycles_per_sample = (double)WWVB_FREQ / (double)SAMPLE_RATE;
+  tc_wave wave;
+  int shifted;
+
+  tc_wave_init (&wave, shape, WWVB_FREQ, SAMPLE_RATE);
+
+  WWVB_SYMBOL_LOW_SAMPLES[TC_ZERO] = SAMPLE_RATE / 5;
+  WWVB_SYMBOL_LOW_SAMPLES[TC_ONE] = SAMPLE_RATE / 2;
+  WWVB_SYMBOL_LOW_SAMPLES[TC_MARKER] = SAMPLE_RATE * 4 / 5;
+  WT_SIZE = tc_wavetable_period (SAMPLE_RATE, WWVB_FREQ, 1);
+  if (nco || trim != 0 || WT_SIZE > TC_WAVETABLE_CAP)
+    {
+      NCO_STEP = nco_step (WWVB_FREQ * (1 + trim / 1e6), SAMPLE_RATE);
+      for (shifted = 0; shifted < 2; shifted++)
+        {
+          nco_table_init (&NCO_HIGH[shifted], &wave, shifted ? -1 : 1,
+                          SAMPLE_FORMAT);
+          nco_table_init (&NCO_LOW[shifted], &wave,
+                          (shifted ? -1 : 1) * LOW_AMPLITUDE, SAMPLE_FORMAT);
+        }
+      return true;
+    }
+  for (shifted = 0; shifted < 2; shifted++)
+    {
+      WT_HIGH[shifted]
+          = tc_wavetable (WT_SIZE, cycles_per_sample, &wave, shifted ? -1 : 1,
+                          SAMPLE_FORMAT, CHANNELS);
+      WT_LOW[shifted]
+          = tc_wavetable (WT_SIZE, cycles_per_sample, &wave,
+                          (shifted ? -1 : 1) * LOW_AMPLITUDE, SAMPLE_FORMAT,
+                          CHANNELS);
+      if (WT_HIGH[shifted] == NULL || WT_LOW[shifted] == NULL)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+wwvb_populate_envelopes (unsigned long ramp)
+{
+  /*  Render WWVB_ENVELOPES with ramps of the given number of samples. Every
+      second starts low after a second that ends high. Returns false if
+      there is not enough memory.
+  */
+  unsigned long low;
+  int sym;
+  int16_t *row;
+
+  WWVB_ENVELOPES
+      = malloc (3 * SAMPLE_RATE * CHANNELS * sizeof *WWVB_ENVELOPES);
+  if (WWVB_ENVELOPES == NULL)
+    {
+      return false;
+    }
+  for (sym = TC_ZERO; sym <= TC_MARKER; sym++)
+    {
+      low = WWVB_SYMBOL_LOW_SAMPLES[sym];
+      row = &WWVB_ENVELOPES[sym * SAMPLE_RATE * CHANNELS];
+      mod_segment (row, low, 1.0, LOW_AMPLITUDE, ramp);
+      mod_segment (&row[low], SAMPLE_RATE - low, LOW_AMPLITUDE, 1.0, ramp);
+      mod_spread (row, SAMPLE_RATE, CHANNELS);
+    }
+  return true;
+}
+
+bool
+wwvb_populate_seconds (void)
+{
+  /*  Render every kind of second into WWVB_SECONDS from the wavetables.
+      Returns false if there is not enough memory.
+  */
+  const tc_symbol symbols[] = { TC_ZERO, TC_ONE, TC_MARKER };
+  unsigned long low;
+  unsigned long index;
+  unsigned char *wave;
+  const int16_t *envelope;
   int i;
+  int start;
+  int shifted;
 
-  for (i = 0; i < WT_SIZE; i++)
+  WWVB_SECONDS = malloc (SECOND_KINDS * SAMPLE_RATE * FRAME_BYTES);
+  if (WWVB_SECONDS == NULL)
     {
-      WT_HIGH[i]
-          = SAMPLE_SCALE * sin ((double)i * 2.0 * PI * cycles_per_sample);
+      return false;
     }
-  for (i = 0; i < WT_SIZE; i++)
+  for (i = 0; i < 3; i++)
     {
-      WT_LOW[i] = SAMPLE_SCALE * 0.02
-                  * sin ((double)i * 2.0 * PI * cycles_per_sample);
+      low = WWVB_SYMBOL_LOW_SAMPLES[symbols[i]];
+      for (start = 0; start < 2; start++)
+        {
+          for (shifted = 0; shifted < 2; shifted++)
+            {
+              wave = wwvb_second_wave (symbols[i], start, shifted);
+              if (WWVB_ENVELOPES != NULL)
+                {
+                  envelope = &WWVB_ENVELOPES[symbols[i] * SAMPLE_RATE
+                                             * CHANNELS];
+                  index = mod_render (wave, PM_SAMPLE, WT_HIGH[start],
+                                      WT_SIZE, 0, envelope, SAMPLE_FORMAT,
+                                      CHANNELS);
+                  mod_render (&wave[PM_SAMPLE * FRAME_BYTES],
+                              SAMPLE_RATE - PM_SAMPLE, WT_HIGH[shifted],
+                              WT_SIZE, index, &envelope[PM_SAMPLE * CHANNELS],
+                              SAMPLE_FORMAT, CHANNELS);
+                  continue;
+                }
+              index = tc_render (wave, PM_SAMPLE, WT_LOW[start], WT_SIZE, 0,
+                                 FRAME_BYTES);
+              index = tc_render (&wave[PM_SAMPLE * FRAME_BYTES],
+                                 low - PM_SAMPLE, WT_LOW[shifted], WT_SIZE,
+                                 index, FRAME_BYTES);
+              tc_render (&wave[low * FRAME_BYTES], SAMPLE_RATE - low,
+                         WT_HIGH[shifted], WT_SIZE, index, FRAME_BYTES);
+            }
+        }
     }
+  return true;
 }
 
 /* CLI flag setter functions */
 
 void
-help_flag_setter (wwvb_args *argsp)
+antiphase_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->antiphase = true;
+}
+
+void
+direct_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->direct = true;
+}
+
+void
+dut1_file_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->dut1_file = value;
+}
+
+void
+format_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->format = value;
+}
+
+void
+help_flag_setter (wwvb_args *argsp, const char *value)
 {
   argsp->help = true;
 }
 
 void
-version_flag_setter (wwvb_args *argsp)
+leap_file_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->leap_file = value;
+}
+
+void
+nco_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->nco = true;
+}
+
+void
+prerender_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->prerender = true;
+}
+
+void
+ramp_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->ramp = value;
+}
+
+void
+rate_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->rate = value;
+}
+
+void
+stats_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->stats = true;
+}
+
+void
+trim_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->trim = value;
+}
+
+void
+utc_offset_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->utc_offset = value;
+}
+
+void
+version_flag_setter (wwvb_args *argsp, const char *value)
 {
   argsp->version = true;
 }
 
+void
+wave_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->wave = value;
+}
+
+void
+zone_flag_setter (wwvb_args *argsp, const char *value)
+{
+  argsp->zone = value;
+}
+
 const wwvb_cli_flag cli_flags[]
-    = { { 'h', "help", "show this help message and exit", help_flag_setter },
-        { 'v', "version", "print version number and exit",
-          version_flag_setter } };
+    = { { 'a', "antiphase", NULL,
+          "play the signal on two channels in antiphase",
+          antiphase_flag_setter },
+        { 'D', "direct", NULL,
+          "synthesize the longwave frequency itself, at 192kHz by default",
+          direct_flag_setter },
+        { 'd', "dut1-file", "PATH", "read DUT1 from the IERS finals file PATH",
+          dut1_file_flag_setter },
+        { 'F', "format", "FORMAT",
+          "output int16 (default), int24, int32 or float32 samples",
+          format_flag_setter },
+        { 'h', "help", NULL, "show this help message and exit",
+          help_flag_setter },
+        { 'l', "leap-file", "PATH", "read leap seconds from PATH",
+          leap_file_flag_setter },
+        { 'n', "nco", NULL,
+          "play the carrier with an NCO rather than a wavetable",
+          nco_flag_setter },
+        { 'p', "prerender", NULL,
+          "prerender each kind of second, using more memory",
+          prerender_flag_setter },
+        { 'r', "ramp", "MS", "shape amplitude edges with MS millisecond ramps",
+          ramp_flag_setter },
+        { 'R', "rate", "HZ", "output audio at HZ samples per second",
+          rate_flag_setter },
+        { 's', "stats", NULL, "print time lookup statistics on exit",
+          stats_flag_setter },
+        { 't', "trim", "PPM",
+          "trim the carrier frequency by PPM parts per million",
+          trim_flag_setter },
+        { 'u', "utc-offset", "OFFSET",
+          "encode UTC plus OFFSET, given as [+-]HH[:MM]",
+          utc_offset_flag_setter },
+        { 'v', "version", NULL, "print version number and exit",
+          version_flag_setter },
+        { 'w', "wave", "SHAPE",
+          "shape the carrier as a sine (default), clipped sine or pulse",
+          wave_flag_setter },
+        { 'z', "zone", "ZONE", "take the DST bits from ZONE instead of TZ",
+          zone_flag_setter } };
 const int flags_count = (sizeof cli_flags) / (sizeof *cli_flags);
 
+bool
+parse_utc_offset (const char *s, long *offset)
+{
+  /*  Parse a UTC offset of the form [+-]HH[:MM], east of Greenwich if
+      positive, into seconds. Returns false if s is not of that form or the
+      offset is a day or more.
+  */
+  long sign = 1;
+  long hours = 0;
+  long minutes = 0;
+  int digits;
+
+  if (*s == '+' || *s == '-')
+    {
+      sign = (*s++ == '-') ? -1 : 1;
+    }
+  for (digits = 0; *s >= '0' && *s <= '9' && digits < 2; digits++)
+    {
+      hours = hours * 10 + (*s++ - '0');
+    }
+  if (digits == 0 || hours > 23)
+    {
+      return false;
+    }
+  if (*s == ':')
+    {
+      s++;
+      for (digits = 0; *s >= '0' && *s <= '9' && digits < 2; digits++)
+        {
+          minutes = minutes * 10 + (*s++ - '0');
+        }
+      if (digits != 2 || minutes > 59)
+        {
+          return false;
+        }
+    }
+  *offset = sign * (hours * 3600 + minutes * 60);
+  return *s == '\0';
+}
+
 bool
 parse_wwvb_args (wwvb_args *argsp, int argc, const char *argv[])
 {
@@ -874,8 +1004,22 @@ parse_wwvb_args (wwvb_args *argsp, int argc, const char *argv[])
   bool flag_char_parsed;
   wwvb_cli_flag *flag;
 
+  argsp->antiphase = false;
+  argsp->direct = false;
   argsp->help = false;
+  argsp->nco = false;
+  argsp->prerender = false;
+  argsp->stats = false;
   argsp->version = false;
+  argsp->dut1_file = NULL;
+  argsp->format = NULL;
+  argsp->leap_file = NULL;
+  argsp->ramp = NULL;
+  argsp->rate = NULL;
+  argsp->trim = NULL;
+  argsp->utc_offset = NULL;
+  argsp->wave = NULL;
+  argsp->zone = NULL;
   for (i = 1; i < argc; i++)
     {
       arg_parsed = false;
@@ -885,8 +1029,15 @@ parse_wwvb_args (wwvb_args *argsp, int argc, const char *argv[])
             {
               if (strcmp (cli_flags[j].long_form, &argv[i][2]) == 0)
                 {
+                  if (cli_flags[j].metavar != NULL && i + 1 >= argc)
+                    {
+                      fprintf (stderr, "Error: CLI flag %s requires %s\n",
+                               argv[i], cli_flags[j].metavar);
+                      return false;
+                    }
                   arg_parsed = true;
-                  cli_flags[j].setter (argsp);
+                  cli_flags[j].setter (
+                      argsp, (cli_flags[j].metavar != NULL) ? argv[++i] : NULL);
                   break;
                 }
             }
@@ -899,12 +1050,37 @@ parse_wwvb_args (wwvb_args *argsp, int argc, const char *argv[])
               flag_char_parsed = false;
               for (k = 0; k < flags_count; k++)
                 {
-                  if (argv[i][j] == cli_flags[k].short_form)
+                  if (argv[i][j] != cli_flags[k].short_form)
                     {
-                      flag_char_parsed = true;
-                      cli_flags[k].setter (argsp);
+                      continue;
+                    }
+                  flag_char_parsed = true;
+                  if (cli_flags[k].metavar == NULL)
+                    {
+                      cli_flags[k].setter (argsp, NULL);
                       break;
                     }
+                  /*  A flag that takes an argument ends the group of short
+                      flags, and its argument is either the rest of this
+                      CLI argument or the next one.
+                  */
+                  if (argv[i][j + 1] != '\0')
+                    {
+                      cli_flags[k].setter (argsp, &argv[i][j + 1]);
+                    }
+                  else if (i + 1 < argc)
+                    {
+                      cli_flags[k].setter (argsp, argv[++i]);
+                    }
+                  else
+                    {
+                      fprintf (stderr, "Error: CLI flag -%c requires %s\n",
+                               cli_flags[k].short_form,
+                               cli_flags[k].metavar);
+                      return false;
+                    }
+                  j = strlen (argv[i]) - 1;
+                  break;
                 }
               if (!flag_char_parsed)
                 {
@@ -931,11 +1107,24 @@ print_help (const char *ename)
   int i;
   int j;
   int spaces;
+  int width;
+  int column = 0;
 
   printf ("usage: %s", display_name);
   for (i = 0; i < flags_count; i++)
     {
-      printf (" [-%c]", cli_flags[i].short_form);
+      if (cli_flags[i].metavar != NULL)
+        {
+          printf (" [-%c %s]", cli_flags[i].short_form, cli_flags[i].metavar);
+          width = strlen (cli_flags[i].long_form)
+                  + strlen (cli_flags[i].metavar) + 1;
+        }
+      else
+        {
+          printf (" [-%c]", cli_flags[i].short_form);
+          width = strlen (cli_flags[i].long_form);
+        }
+      column = (width + 2 > column) ? width + 2 : column;
     }
   printf ("\n\n");
   printf ("Output audio simulating WWVB radio time signal\n\n");
@@ -943,7 +1132,12 @@ print_help (const char *ename)
   for (i = 0; i < flags_count; i++)
     {
       printf ("  -%c, --%s", cli_flags[i].short_form, cli_flags[i].long_form);
-      spaces = 9 - strlen (cli_flags[i].long_form);
+      spaces = column - strlen (cli_flags[i].long_form);
+      if (cli_flags[i].metavar != NULL)
+        {
+          printf (" %s", cli_flags[i].metavar);
+          spaces -= strlen (cli_flags[i].metavar) + 1;
+        }
       for (j = 0; j < spaces; j++)
         {
           printf (" ");
@@ -958,6 +1152,21 @@ print_version (void)
   printf ("v%d.%d\n", ERSATZ_JJY_VERSION_MAJOR, ERSATZ_JJY_VERSION_MINOR);
 }
 
+void
+print_stats (long seconds)
+{
+  /*  Every calendar breakdown, time zone lookup and clock read counts
+      itself, including those made at startup. After startup, the encoder
+      breaks down a time only when it rebuilds its fields once per UTC day,
+      and looks up the time zone a few times per UTC year, so this should
+      stay well below one lookup per second.
+  */
+  const unsigned long calls = tc_time_calls ();
+
+  printf ("%lu time lookups in %ld seconds (%.4f per second)\n", calls,
+          seconds, (seconds > 0) ? (double)calls / seconds : 0.0);
+}
+
 void
 handle_keyboard_interrupt (int sig)
 {
@@ -977,8 +1186,14 @@ main (int argc, const char *argv[])
   wwvb_args args;
   PaStreamParameters outputParameters;
   PaError err;
-  struct timespec now;
+  leap_utc now;
+  const char *leap_path;
+  unsigned long ramp = 0;
+  double trim = 0;
+  tc_shape shape = TC_SINE;
+  tc_symbol sym;
   wwvb_data data;
+  time_t start;
 
   if (!parse_wwvb_args (&args, argc, argv))
     {
@@ -997,15 +1212,138 @@ main (int argc, const char *argv[])
 
   printf ("ersatz-wwvb v%d.%d\n", ERSATZ_JJY_VERSION_MAJOR,
           ERSATZ_JJY_VERSION_MINOR);
-  wwvb_populate_wavetables (WT_HIGH, WT_LOW);
+  leap_path = (args.leap_file != NULL) ? args.leap_file : LEAP_DEFAULT_PATH;
+  if (!leap_table_load (&LEAP_TABLE, leap_path))
+    {
+      if (args.leap_file != NULL)
+        {
+          fprintf (stderr, "Error: Could not read leap seconds from %s\n",
+                   leap_path);
+          return 1;
+        }
+      fprintf (stderr, "Warning: Could not read %s, leap seconds will not be "
+                       "announced\n",
+               leap_path);
+    }
+  else if (LEAP_TABLE.expires != 0 && LEAP_TABLE.expires < time (NULL))
+    {
+      fprintf (stderr, "Warning: Leap second list %s has expired\n",
+               leap_path);
+    }
+  if (args.dut1_file != NULL)
+    {
+      if (!dut1_table_load (&DUT1_TABLE, args.dut1_file))
+        {
+          fprintf (stderr, "Error: Could not read DUT1 from %s\n",
+                   args.dut1_file);
+          return 1;
+        }
+      if (!dut1_covers (&DUT1_TABLE, time (NULL)))
+        {
+          fprintf (stderr, "Warning: DUT1 file %s does not cover today, "
+                           "sending DUT1 of +0.0s\n",
+                   args.dut1_file);
+        }
+    }
+  data.offset = 0;
+  if (args.utc_offset != NULL
+      && !parse_utc_offset (args.utc_offset, &data.offset))
+    {
+      fprintf (stderr, "Error: Invalid UTC offset %s\n", args.utc_offset);
+      return 1;
+    }
+  SAMPLE_RATE = args.direct ? TC_DIRECT_RATE : DEFAULT_RATE;
+  if (args.rate != NULL && !tc_parse_rate (args.rate, &SAMPLE_RATE))
+    {
+      fprintf (stderr, "Error: Invalid sample rate %s, expected %d to %d Hz\n",
+               args.rate, TC_MIN_RATE, TC_MAX_RATE);
+      return 1;
+    }
+  /*  Without --direct, the carrier is one-third of the longwave frequency,
+      relying on the speaker to radiate its third harmonic
+  */
+  WWVB_FREQ = args.direct ? WWVB_LONGWAVE_FREQ : WWVB_LONGWAVE_FREQ / 3;
+  if (SAMPLE_RATE <= 2 * WWVB_FREQ)
+    {
+      fprintf (stderr, "Error: A sample rate of %lu Hz cannot carry a %lu Hz "
+                       "signal\n",
+               SAMPLE_RATE, WWVB_FREQ);
+      return 1;
+    }
+  SAMPLE_FORMAT = TC_INT16;
+  if (args.format != NULL && !tc_parse_format (args.format, &SAMPLE_FORMAT))
+    {
+      fprintf (stderr, "Error: Invalid sample format %s\n", args.format);
+      return 1;
+    }
+  if (args.wave != NULL && !tc_parse_shape (args.wave, &shape))
+    {
+      fprintf (stderr, "Error: Invalid waveshape %s\n", args.wave);
+      return 1;
+    }
+  if (args.direct && shape != TC_SINE)
+    {
+      fprintf (stderr, "Warning: Waveshapes only help a carrier at one-third "
+                       "of the longwave frequency, playing a sine\n");
+      shape = TC_SINE;
+    }
+  CHANNELS = args.antiphase ? 2 : 1;
+  FRAME_BYTES = tc_sample_size (SAMPLE_FORMAT) * CHANNELS;
+  if (args.ramp != NULL && !mod_parse_ramp (args.ramp, SAMPLE_RATE, &ramp))
+    {
+      fprintf (stderr, "Error: Invalid ramp length %s, expected 0 to %d ms\n",
+               args.ramp, MOD_MAX_RAMP_MS);
+      return 1;
+    }
+  if (args.trim != NULL && !nco_parse_trim (args.trim, &trim))
+    {
+      fprintf (stderr, "Error: Invalid trim %s, expected -%d to %d ppm\n",
+               args.trim, NCO_MAX_TRIM_PPM, NCO_MAX_TRIM_PPM);
+      return 1;
+    }
+  if (!wwvb_open_local_zone (args.zone))
+    {
+      fprintf (stderr, "Error: Could not read time zone %s\n", args.zone);
+      return 1;
+    }
+  if (!wwvb_populate_wavetables (args.nco, trim, shape))
+    {
+      fprintf (stderr, "Error: Not enough memory for the wavetables\n");
+      return 1;
+    }
+  if (shape != TC_SINE && SAMPLE_RATE <= 6 * WWVB_FREQ)
+    {
+      fprintf (stderr, "Warning: A sample rate of %lu Hz cannot carry the "
+                       "third harmonic of a %lu Hz carrier, playing a sine\n",
+               SAMPLE_RATE, WWVB_FREQ);
+    }
+  if (ramp > 0)
+    {
+      mod_init ();
+      if (!wwvb_populate_envelopes (ramp))
+        {
+          fprintf (stderr, "Warning: Not enough memory to shape amplitude "
+                           "edges\n");
+        }
+    }
+  if (args.prerender && NCO_STEP != 0)
+    {
+      fprintf (stderr, "Warning: Seconds cannot be prerendered with an NCO, "
+                       "rendering them live\n");
+    }
+  else if (args.prerender && !wwvb_populate_seconds ())
+    {
+      fprintf (stderr, "Warning: Not enough memory to prerender seconds, "
+                       "rendering them live\n");
+    }
   err = Pa_Initialize ();
   if (err != paNoError)
     {
       return handle_pa_err (err);
     }
   outputParameters.device = Pa_GetDefaultOutputDevice ();
-  outputParameters.channelCount = 1;
-  outputParameters.sampleFormat = paInt16;
+  outputParameters.channelCount = CHANNELS;
+  outputParameters.sampleFormat = PA_FORMATS[SAMPLE_FORMAT];
   outputParameters.suggestedLatency
       = Pa_GetDeviceInfo (outputParameters.device)->defaultLowOutputLatency;
   outputParameters.hostApiSpecificStreamInfo = NULL;
@@ -1019,11 +1357,29 @@ main (int argc, const char *argv[])
   signal (SIGINT, handle_keyboard_interrupt);
   signal (SIGTERM, handle_keyboard_interrupt);
 
-  timespec_get (&now, TIME_UTC);
-  data.seconds = now.tv_sec;
-  data.sample_index = now.tv_nsec * SAMPLE_RATE / MAX_NANOSEC;
+  leap_utc_now (&LEAP_TABLE, &now);
+  data.minute = now.minute;
+  data.second = now.second;
+  data.sample_index = now.nsec * SAMPLE_RATE / MAX_NANOSEC;
   data.wt_index = data.sample_index % WT_SIZE;
-  data.low_samples = sec_low_samples (&data.seconds);
+  data.phase = (uint32_t)(NCO_STEP * data.sample_index);
+  data.shifted = false;
+  data.dst_year.year = -1;
+  data.extended_start = -1;
+  start = now.minute + now.second;
+  wwvb_rebuild_fields (&data);
+  data.playing = 0;
+  wwvb_build_minute (&data, &data.minutes[0]);
+  atomic_init (&data.next_ready, false);
+  atomic_init (&data.frame, 0);
+  data.next_frame = 0;
+  wwvb_prepare_next (&data);
+  sym = tc_frame_symbol (&data.minutes[0].frame, data.second);
+  data.low_samples = WWVB_SYMBOL_LOW_SAMPLES[sym];
+  data.wave = NULL; /* The first, partial second is rendered live */
+  data.envelope = (WWVB_ENVELOPES != NULL)
+                      ? &WWVB_ENVELOPES[sym * SAMPLE_RATE * CHANNELS]
+                      : NULL;
   err = Pa_StartStream (STREAM);
   if (err != paNoError)
     {
@@ -1031,6 +1387,7 @@ main (int argc, const char *argv[])
     }
   while (Pa_IsStreamActive (STREAM))
     {
+      wwvb_prepare_next (&data);
       Pa_Sleep (500);
     }
   err = Pa_CloseStream (STREAM);
@@ -1038,6 +1395,10 @@ main (int argc, const char *argv[])
     {
       return handle_pa_err (err);
     }
+  if (args.stats)
+    {
+      print_stats (time (NULL) - start);
+    }
   err = Pa_Terminate ();
   return err;
 }
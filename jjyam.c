@@ -0,0 +1,99 @@
+/*  jjyam: JJY amplitude modulation time code for ersatz-jjy
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "jjyam.h"
+
+/*  Seconds 40-48 of minutes 15 and 45, which carry the call sign, and seconds
+    50-55, which carry service interruption warnings during those minutes
+*/
+const uint64_t JJY_CALL_SIGN_MASK = ((1ULL << JJY_CALL_SIGN_SECONDS) - 1)
+                                    << JJY_CALL_SIGN_FIRST_SEC;
+const uint64_t JJY_SERVICE_MASK = 0x3fULL << 50;
+
+/*  Layout of the JJY time code: which weight of which BCD field each second
+    encodes. Seconds not listed here encode markers, parity bits, or a
+    constant value of 0.
+
+    In minutes 15 and 45 of every hour the JJY time code follows an altered
+    format where bits 40-48 are replaced by a Morse code station identifier
+    and bits 50 through 55 are replaced by bits providing information about
+    upcoming planned service interruptions; jjy_encode_frame() overlays this
+    format on the layout below.
+*/
+const tc_bit JJY_LAYOUT[] = {
+  TC_BIT (TC_MINUTE, 40, 1), TC_BIT (TC_MINUTE, 20, 2),
+  TC_BIT (TC_MINUTE, 10, 3), TC_BIT (TC_MINUTE, 8, 5),
+  TC_BIT (TC_MINUTE, 4, 6),  TC_BIT (TC_MINUTE, 2, 7),
+  TC_BIT (TC_MINUTE, 1, 8),  TC_BIT (TC_HOUR, 20, 12),
+  TC_BIT (TC_HOUR, 10, 13),  TC_BIT (TC_HOUR, 8, 15),
+  TC_BIT (TC_HOUR, 4, 16),   TC_BIT (TC_HOUR, 2, 17),
+  TC_BIT (TC_HOUR, 1, 18),   TC_BIT (TC_YDAY, 200, 22),
+  TC_BIT (TC_YDAY, 100, 23), TC_BIT (TC_YDAY, 80, 25),
+  TC_BIT (TC_YDAY, 40, 26),  TC_BIT (TC_YDAY, 20, 27),
+  TC_BIT (TC_YDAY, 10, 28),  TC_BIT (TC_YDAY, 8, 30),
+  TC_BIT (TC_YDAY, 4, 31),   TC_BIT (TC_YDAY, 2, 32),
+  TC_BIT (TC_YDAY, 1, 33),   TC_BIT (TC_YEAR, 80, 41),
+  TC_BIT (TC_YEAR, 40, 42),  TC_BIT (TC_YEAR, 20, 43),
+  TC_BIT (TC_YEAR, 10, 44),  TC_BIT (TC_YEAR, 8, 45),
+  TC_BIT (TC_YEAR, 4, 46),   TC_BIT (TC_YEAR, 2, 47),
+  TC_BIT (TC_YEAR, 1, 48),   TC_BIT (TC_WDAY, 4, 50),
+  TC_BIT (TC_WDAY, 2, 51),   TC_BIT (TC_WDAY, 1, 52)
+};
+const int JJY_LAYOUT_COUNT = (sizeof JJY_LAYOUT) / (sizeof *JJY_LAYOUT);
+
+/*  Bits 53 and 54 warn about upcoming leap seconds. A bit 53 value of 1
+    (true) indicates that the current UTC month ends with a leap second; if a
+    leap second is upcoming then bit 54 indicates whether it will be a
+    positive leap second (1) or a negative leap second (0). Many
+    implementations of the time_t type that stores datetimes in C (especially
+    on POSIX systems) are not leap second-aware, so upcoming leap seconds are
+    looked up in LEAP_TABLE instead. The minute that ends in the leap second
+    itself is one second longer or shorter, as described in tc_markers().
+*/
+
+void
+jjy_encode_frame (const unsigned int bcd[TC_FIELD_COUNT], leap_kind leap,
+                  int length, tc_frame *f)
+{
+  /*  Encode every second of the minute with the given BCD calendar fields,
+      leap second warning and length in seconds into f. This runs once per
+      minute, so the audio callback only has to look up one packed symbol at
+      each second boundary.
+  */
+  const uint64_t markers = tc_markers (length);
+  uint64_t ones;
+
+  ones = tc_emit (JJY_LAYOUT, JJY_LAYOUT_COUNT, bcd);
+  /*  Bit 36 is even parity over the hour bits 12-18 and bit 37 is even
+      parity over the minute bits 1-8. Bits 4 and 14 have a constant value of
+      0, so this is the parity of the BCD hour and minute values themselves.
+  */
+  ones |= (uint64_t)tc_parity (bcd[TC_HOUR]) << 36;
+  ones |= (uint64_t)tc_parity (bcd[TC_MINUTE]) << 37;
+  ones |= ((uint64_t)(leap != LEAP_NONE) << 53)
+          | ((uint64_t)(leap == LEAP_POSITIVE) << 54);
+  ones &= ~markers;
+  if (bcd[TC_MINUTE] == 0x15 || bcd[TC_MINUTE] == 0x45)
+    {
+      /*  Call sign minute. Service interruption bits 50-55 are all 0, which
+          announces that no interruption is planned.
+      */
+      ones &= ~(JJY_CALL_SIGN_MASK | JJY_SERVICE_MASK);
+      tc_pack_frame (ones | JJY_CALL_SIGN_MASK, markers | JJY_CALL_SIGN_MASK,
+                     length, f);
+      return;
+    }
+  tc_pack_frame (ones, markers, length, f);
+}
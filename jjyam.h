@@ -0,0 +1,34 @@
+/*  jjyam: JJY amplitude modulation time code for ersatz-jjy
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef JJYAM_H
+#define JJYAM_H
+
+#include "leapsec.h"
+#include "timecode.h"
+#include <stdint.h>
+
+#define JJY_CALL_SIGN_FIRST_SEC (40) /* First second of the Morse call sign */
+#define JJY_CALL_SIGN_SECONDS (9)    /* Seconds 40-48 carry the call sign */
+
+extern const uint64_t JJY_CALL_SIGN_MASK;
+extern const uint64_t JJY_SERVICE_MASK;
+extern const tc_bit JJY_LAYOUT[];
+extern const int JJY_LAYOUT_COUNT;
+
+void jjy_encode_frame (const unsigned int bcd[TC_FIELD_COUNT], leap_kind leap,
+                       int length, tc_frame *f);
+
+#endif /* JJYAM_H */
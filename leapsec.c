@@ -0,0 +1,235 @@
+/*  leapsec: Leap second table shared by ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "leapsec.h"
+#include "timecode.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Seconds from the NTP epoch (1900) to the Unix epoch (1970) */
+#define NTP_UNIX_OFFSET (2208988800LL)
+#define MIN_TAI_OFFSET (10) /* TAI-UTC when leap seconds were introduced */
+#define LINE_CAP (256)
+
+static time_t
+month_start_before (time_t t)
+{
+  /* Return the start of the UTC month containing the second before t */
+  time_t last = t - 1;
+  struct tm utc;
+
+  tc_breakdown (last, &utc);
+  return last - (((utc.tm_mday - 1) * 24 + utc.tm_hour) * 3600L
+                 + utc.tm_min * 60 + utc.tm_sec);
+}
+
+#ifdef CLOCK_TAI
+static int
+read_tai (struct timespec *tai)
+{
+  /* Read the kernel's TAI clock, counted like the other clock reads */
+  tc_count_time_call ();
+  return clock_gettime (CLOCK_TAI, tai);
+}
+#endif
+
+bool
+leap_table_load (leap_table *lt, const char *path)
+{
+  /*  Read a leap-seconds.list file in the format distributed by the IERS
+      and with tzdata. Each data line holds an NTP timestamp and the TAI-UTC
+      offset that applies from that time, and a "#@" line holds the NTP
+      timestamp when the list expires. Returns false if the file cannot be
+      read or is not sorted.
+  */
+  FILE *f;
+  char line[LINE_CAP];
+  long long ntp;
+  int offset;
+  leap_entry *entries;
+  leap_entry *e;
+
+  lt->entries = NULL;
+  lt->count = 0;
+  lt->cursor = 0;
+  lt->expires = 0;
+  f = fopen (path, "r");
+  if (f == NULL)
+    {
+      return false;
+    }
+  while (fgets (line, LINE_CAP, f) != NULL)
+    {
+      if (line[0] == '#')
+        {
+          if (line[1] == '@' && sscanf (&line[2], "%lld", &ntp) == 1)
+            {
+              lt->expires = (time_t)(ntp - NTP_UNIX_OFFSET);
+            }
+          continue;
+        }
+      if (sscanf (line, "%lld %d", &ntp, &offset) != 2)
+        {
+          continue;
+        }
+      entries = realloc (lt->entries, (lt->count + 1) * sizeof *entries);
+      if (entries == NULL)
+        {
+          break;
+        }
+      lt->entries = entries;
+      e = &lt->entries[lt->count];
+      e->effective = (time_t)(ntp - NTP_UNIX_OFFSET);
+      e->month_start = month_start_before (e->effective);
+      e->tai_offset = offset;
+      /* The first entry starts the table rather than marking a leap second */
+      e->kind = LEAP_NONE;
+      if (lt->count > 0)
+        {
+          if (e->effective <= e[-1].effective)
+            {
+              fprintf (stderr, "Error: %s is not sorted by time\n", path);
+              fclose (f);
+              free (lt->entries);
+              lt->entries = NULL;
+              lt->count = 0;
+              return false;
+            }
+          e->kind = (offset > e[-1].tai_offset)   ? LEAP_POSITIVE
+                    : (offset < e[-1].tai_offset) ? LEAP_NEGATIVE
+                                                  : LEAP_NONE;
+        }
+      lt->count += 1;
+    }
+  fclose (f);
+  return true;
+}
+
+static void
+leap_table_seek (leap_table *lt, time_t t)
+{
+  /* Binary search for the first entry that is not yet in effect at t */
+  int lo = 0;
+  int hi = lt->count;
+  int mid;
+
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (lt->entries[mid].effective <= t)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  lt->cursor = lo;
+}
+
+leap_kind
+leap_month_state (leap_table *lt, time_t t)
+{
+  /*  Return the kind of leap second, if any, that ends the UTC month
+      containing t. Time normally only moves forward by a minute or so
+      between calls, so this usually just compares t with the entry at the
+      cursor; a jump backwards or across several entries falls back to a
+      binary search.
+  */
+  const leap_entry *next;
+
+  if ((lt->cursor > 0 && t < lt->entries[lt->cursor - 1].effective)
+      || (lt->cursor + 1 < lt->count
+          && t >= lt->entries[lt->cursor + 1].effective))
+    {
+      leap_table_seek (lt, t);
+    }
+  else if (lt->cursor < lt->count && t >= lt->entries[lt->cursor].effective)
+    {
+      lt->cursor += 1;
+    }
+  if (lt->cursor >= lt->count)
+    {
+      return LEAP_NONE;
+    }
+  next = &lt->entries[lt->cursor];
+  return (t >= next->month_start) ? next->kind : LEAP_NONE;
+}
+
+int
+leap_minute_length (leap_table *lt, time_t minute)
+{
+  /*  Return the number of seconds in the UTC minute starting at the POSIX
+      time minute: 61 if it ends in a positive leap second, 59 if it ends in a
+      negative leap second, and 60 otherwise.
+  */
+  const leap_kind kind = leap_month_state (lt, minute);
+
+  if (kind != LEAP_NONE
+      && lt->entries[lt->cursor].effective == minute + 60)
+    {
+      return 60 + kind;
+    }
+  return 60;
+}
+
+void
+leap_utc_now (const leap_table *lt, leap_utc *now)
+{
+  /*  Read the current time. POSIX system time cannot represent a leap
+      second, so where the kernel keeps TAI (which has no leap seconds), read
+      that instead and convert it to UTC using the leap second table. If the
+      kernel's TAI clock has not been set up, it reads the same as system
+      time, and system time is used directly.
+  */
+  struct timespec utc;
+#ifdef CLOCK_TAI
+  struct timespec tai;
+  int i;
+#endif
+  time_t posix;
+
+  timespec_get (&utc, TIME_UTC);
+  tc_count_time_call ();
+  posix = utc.tv_sec;
+  now->second = (int)(posix % 60);
+  now->nsec = utc.tv_nsec;
+#ifdef CLOCK_TAI
+  if (lt->count > 0 && read_tai (&tai) == 0
+      && tai.tv_sec - utc.tv_sec >= MIN_TAI_OFFSET)
+    {
+      /* Find the last entry in effect, measured in TAI */
+      for (i = lt->count - 1;
+           i > 0 && tai.tv_sec < lt->entries[i].effective
+                                     + lt->entries[i].tai_offset;
+           i--)
+        ;
+      posix = tai.tv_sec - lt->entries[i].tai_offset;
+      now->second = (int)(posix % 60);
+      now->nsec = tai.tv_nsec;
+      if (i + 1 < lt->count && lt->entries[i + 1].kind == LEAP_POSITIVE
+          && posix >= lt->entries[i + 1].effective)
+        {
+          /* This is the leap second at the end of the previous minute */
+          posix = lt->entries[i + 1].effective - 1;
+          now->second = 60;
+        }
+    }
+#else
+  (void)lt;
+#endif
+  now->minute = posix - (posix % 60);
+}
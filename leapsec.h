@@ -0,0 +1,73 @@
+/*  leapsec: Leap second table shared by ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef LEAPSEC_H
+#define LEAPSEC_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/* Default location of the leap second list distributed with tzdata */
+#define LEAP_DEFAULT_PATH "/usr/share/zoneinfo/leap-seconds.list"
+
+typedef enum
+{
+  LEAP_NONE = 0,
+  LEAP_POSITIVE = 1,
+  LEAP_NEGATIVE = -1
+} leap_kind;
+
+/*  One change of TAI-UTC. A leap second of the given kind ends the UTC month
+    that starts at month_start, and the new offset applies from effective,
+    the first instant of the following month.
+*/
+typedef struct
+{
+  time_t month_start;
+  time_t effective;
+  int tai_offset; /* TAI-UTC in seconds from effective onwards */
+  leap_kind kind;
+} leap_entry;
+
+/*  Leap second entries sorted by time, as read from a leap-seconds.list
+    file. cursor is the index of the first entry not yet in effect at the
+    time of the last lookup, which makes lookups for steadily increasing
+    times O(1).
+*/
+typedef struct
+{
+  leap_entry *entries;
+  int count;
+  int cursor;
+  time_t expires; /* The list is not authoritative after this time */
+} leap_table;
+
+/*  A moment in UTC including leap seconds: the POSIX time of the start of
+    its minute, the second within that minute (which is 60 during a positive
+    leap second), and nanoseconds within that second.
+*/
+typedef struct
+{
+  time_t minute;
+  int second;
+  long nsec;
+} leap_utc;
+
+bool leap_table_load (leap_table *lt, const char *path);
+leap_kind leap_month_state (leap_table *lt, time_t t);
+int leap_minute_length (leap_table *lt, time_t minute);
+void leap_utc_now (const leap_table *lt, leap_utc *now);
+
+#endif /* LEAPSEC_H */
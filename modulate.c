@@ -0,0 +1,308 @@
+/*  modulate: Carrier times envelope kernels for ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "modulate.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  The vector kernels are built with the target attribute and picked at run
+    time, so one binary runs on any x86 CPU. Other compilers and CPUs only
+    get the scalar kernel.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MOD_X86 1
+#include <immintrin.h>
+#endif
+
+static void
+mod_apply_scalar (int16_t *out, const int16_t *carrier,
+                  const int16_t *envelope, unsigned long count)
+{
+  unsigned long i;
+
+  for (i = 0; i < count; i++)
+    {
+      out[i] = (int16_t)(((int32_t)carrier[i] * envelope[i]) >> 15);
+    }
+}
+
+#ifdef MOD_X86
+/*  Bits 15-30 of each 32-bit product are the high half shifted left by one,
+    with bit 15 of the low half shifted in, which is the same as the scalar
+    kernel's shift.
+*/
+
+__attribute__ ((target ("sse2"))) static void
+mod_apply_sse2 (int16_t *out, const int16_t *carrier, const int16_t *envelope,
+                unsigned long count)
+{
+  unsigned long i;
+  __m128i c;
+  __m128i e;
+
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      c = _mm_loadu_si128 ((const __m128i *)&carrier[i]);
+      e = _mm_loadu_si128 ((const __m128i *)&envelope[i]);
+      _mm_storeu_si128 (
+          (__m128i *)&out[i],
+          _mm_or_si128 (_mm_slli_epi16 (_mm_mulhi_epi16 (c, e), 1),
+                        _mm_srli_epi16 (_mm_mullo_epi16 (c, e), 15)));
+    }
+  mod_apply_scalar (&out[i], &carrier[i], &envelope[i], count - i);
+}
+
+__attribute__ ((target ("avx2"))) static void
+mod_apply_avx2 (int16_t *out, const int16_t *carrier, const int16_t *envelope,
+                unsigned long count)
+{
+  unsigned long i;
+  __m256i c;
+  __m256i e;
+
+  for (i = 0; i + 16 <= count; i += 16)
+    {
+      c = _mm256_loadu_si256 ((const __m256i *)&carrier[i]);
+      e = _mm256_loadu_si256 ((const __m256i *)&envelope[i]);
+      _mm256_storeu_si256 (
+          (__m256i *)&out[i],
+          _mm256_or_si256 (_mm256_slli_epi16 (_mm256_mulhi_epi16 (c, e), 1),
+                           _mm256_srli_epi16 (_mm256_mullo_epi16 (c, e), 15)));
+    }
+  mod_apply_scalar (&out[i], &carrier[i], &envelope[i], count - i);
+}
+#endif /* MOD_X86 */
+
+static void
+mod_apply_wide (void *out, const void *carrier, const int16_t *envelope,
+                unsigned long count, tc_format format)
+{
+  /*  The same product for the wider formats, which have no vector kernel:
+      integers are shifted the same way, and floats scaled so that
+      MOD_UNITY leaves them unchanged, which needs the envelope scaled
+      first.
+  */
+  unsigned long i;
+
+  switch (format)
+    {
+    case TC_INT24:
+      for (i = 0; i < count; i++)
+        {
+          tc_pack24 ((unsigned char *)out + i * 3,
+                     (int32_t)(((int64_t)tc_unpack24 (
+                                    (const unsigned char *)carrier + i * 3)
+                                * envelope[i])
+                               >> 15));
+        }
+      break;
+    case TC_INT32:
+      for (i = 0; i < count; i++)
+        {
+          ((int32_t *)out)[i] = (int32_t)(
+              ((int64_t)((const int32_t *)carrier)[i] * envelope[i]) >> 15);
+        }
+      break;
+    case TC_FLOAT32:
+      for (i = 0; i < count; i++)
+        {
+          ((float *)out)[i] = ((const float *)carrier)[i]
+                              * (envelope[i] * (1.0f / MOD_UNITY));
+        }
+      break;
+    default:
+      mod_apply_scalar (out, carrier, envelope, count);
+      break;
+    }
+}
+
+static mod_kernel KERNEL = mod_apply_scalar;
+static const char *KERNEL_NAME = "scalar";
+
+void
+mod_init (void)
+{
+  /* Pick the widest kernel the CPU supports; call once at startup */
+#ifdef MOD_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    {
+      KERNEL = mod_apply_avx2;
+      KERNEL_NAME = "avx2";
+      return;
+    }
+  if (__builtin_cpu_supports ("sse2"))
+    {
+      KERNEL = mod_apply_sse2;
+      KERNEL_NAME = "sse2";
+      return;
+    }
+#endif
+  KERNEL = mod_apply_scalar;
+  KERNEL_NAME = "scalar";
+}
+
+const char *
+mod_kernel_name (void)
+{
+  return KERNEL_NAME;
+}
+
+bool
+mod_use (const char *name)
+{
+  /*  Use the kernel with the given name ("scalar", "sse2" or "avx2")
+      instead of the one mod_init() picked, for tests and benchmarks.
+      Returns false if there is no such kernel or the CPU lacks it.
+  */
+#ifdef MOD_X86
+  __builtin_cpu_init ();
+  if (strcmp (name, "avx2") == 0 && __builtin_cpu_supports ("avx2"))
+    {
+      KERNEL = mod_apply_avx2;
+      KERNEL_NAME = "avx2";
+      return true;
+    }
+  if (strcmp (name, "sse2") == 0 && __builtin_cpu_supports ("sse2"))
+    {
+      KERNEL = mod_apply_sse2;
+      KERNEL_NAME = "sse2";
+      return true;
+    }
+#endif
+  if (strcmp (name, "scalar") == 0)
+    {
+      KERNEL = mod_apply_scalar;
+      KERNEL_NAME = "scalar";
+      return true;
+    }
+  return false;
+}
+
+void
+mod_apply (void *out, const void *carrier, const int16_t *envelope,
+           unsigned long count, tc_format format)
+{
+  /*  Multiply count samples of carrier by envelope with the kernel picked by
+      mod_init(). out may be the same buffer as carrier.
+  */
+  if (format == TC_INT16)
+    {
+      KERNEL (out, carrier, envelope, count);
+      return;
+    }
+  mod_apply_wide (out, carrier, envelope, count, format);
+}
+
+unsigned long
+mod_render (void *out, unsigned long count, const void *wt,
+            unsigned long period, unsigned long index,
+            const int16_t *envelope, tc_format format, int channels)
+{
+  /*  Like tc_render(), but multiply the wavetable frames by count frames of
+      envelope on the way. The envelope is spread over the channels by
+      mod_spread(), so every channel of a frame goes through the kernel in
+      the same pass.
+  */
+  const size_t frame = tc_sample_size (format) * channels;
+  unsigned char *dest = out;
+  const unsigned char *src = wt;
+  unsigned long n;
+
+  while (count > 0)
+    {
+      n = (count < TC_RENDER_CHUNK) ? count : TC_RENDER_CHUNK;
+      mod_apply (dest, &src[index * frame], envelope, n * channels, format);
+      dest += n * frame;
+      envelope += n * channels;
+      count -= n;
+      index += n;
+      if (index >= period)
+        {
+          index %= period;
+        }
+    }
+  return index;
+}
+
+bool
+mod_parse_ramp (const char *text, long sample_rate, unsigned long *samples)
+{
+  /*  Parse a ramp length given in whole milliseconds on the command line,
+      from 0 to MOD_MAX_RAMP_MS, into samples
+  */
+  char *end;
+  long ms = strtol (text, &end, 10);
+
+  if (end == text || *end != '\0' || ms < 0 || ms > MOD_MAX_RAMP_MS)
+    {
+      return false;
+    }
+  *samples = (unsigned long)(ms * sample_rate / 1000);
+  return true;
+}
+
+int16_t
+mod_level (double amplitude)
+{
+  /* Envelope value for a fraction of full amplitude */
+  return (int16_t)lround (amplitude * MOD_UNITY);
+}
+
+void
+mod_segment (int16_t *envelope, unsigned long count, double from, double to,
+             unsigned long ramp)
+{
+  /*  Fill count samples of envelope at amplitude to, starting with a
+      raised-cosine ramp of up to ramp samples from amplitude from. The
+      ramp is cut short if the segment is shorter than it.
+  */
+  const double PI = acos (-1);
+  unsigned long i;
+
+  if (from == to)
+    {
+      ramp = 0;
+    }
+  for (i = 0; i < count && i < ramp; i++)
+    {
+      envelope[i] = mod_level (
+          from + (to - from) * (1 - cos (PI * (i + 0.5) / ramp)) / 2);
+    }
+  for (; i < count; i++)
+    {
+      envelope[i] = mod_level (to);
+    }
+}
+
+void
+mod_spread (int16_t *envelope, unsigned long count, int channels)
+{
+  /*  Repeat each of the first count values of envelope once per channel, in
+      place, so it lines up with frames of that many channels. envelope
+      must hold count * channels values.
+  */
+  unsigned long i;
+  int c;
+
+  for (i = count; i-- > 0;)
+    {
+      for (c = channels - 1; c >= 0; c--)
+        {
+          envelope[i * channels + c] = envelope[i];
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/*  modulate: Carrier times envelope kernels for ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef MODULATE_H
+#define MODULATE_H
+
+#include "timecode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOD_UNITY (32767) /* Envelope value for full amplitude */
+#define MOD_MAX_RAMP_MS (20) /* Longest ramp --ramp accepts */
+
+/*  Multiply count carrier samples by an envelope of the same length into
+    out. Envelope values are fractions of full amplitude in Q15, from 0 to
+    MOD_UNITY, so every kernel gives exactly (carrier * envelope) >> 15.
+    These are for TC_INT16 samples; other formats use a scalar loop.
+*/
+typedef void (*mod_kernel) (int16_t *out, const int16_t *carrier,
+                            const int16_t *envelope, unsigned long count);
+
+void mod_init (void);
+const char *mod_kernel_name (void);
+bool mod_use (const char *name);
+void mod_apply (void *out, const void *carrier, const int16_t *envelope,
+                unsigned long count, tc_format format);
+unsigned long mod_render (void *out, unsigned long count, const void *wt,
+                          unsigned long period, unsigned long index,
+                          const int16_t *envelope, tc_format format,
+                          int channels);
+bool mod_parse_ramp (const char *text, long sample_rate,
+                     unsigned long *samples);
+int16_t mod_level (double amplitude);
+void mod_segment (int16_t *envelope, unsigned long count, double from,
+                  double to, unsigned long ramp);
+void mod_spread (int16_t *envelope, unsigned long count, int channels);
+
+#endif /* MODULATE_H */
@@ -0,0 +1,179 @@
+/*  nco: Numerically controlled oscillator for ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "nco.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*  The phase is a 32-bit fraction of a cycle: the top two bits pick the
+    quarter and the next NCO_QUARTER_BITS the step within it.
+*/
+#define STEP_SHIFT (30 - NCO_QUARTER_BITS)
+
+void
+nco_table_init (nco_table *t, const tc_wave *w, double amplitude,
+                tc_format format)
+{
+  /*  Fill t with a quarter cycle of the waveshape w at amplitude, a
+      fraction of full scale
+  */
+  const double PI = acos (-1);
+  const double scale = tc_full_scale (format) * amplitude;
+  double value;
+  int i;
+
+  t->format = format;
+  for (i = 0; i < NCO_QUARTER; i++)
+    {
+      value = scale * tc_wave_value (w, PI / 2 * (i + 0.5) / NCO_QUARTER);
+      if (format == TC_FLOAT32)
+        {
+          t->quarter.f[i] = (float)value;
+        }
+      else
+        {
+          t->quarter.i[i] = (int32_t)lround (value);
+        }
+    }
+}
+
+uint32_t
+nco_step (double freq, unsigned long rate)
+{
+  /* Phase increment per sample for a carrier of freq Hz */
+  return (uint32_t)llround (freq / rate * 4294967296.0);
+}
+
+static inline uint32_t
+nco_index (uint32_t phase)
+{
+  /*  Index into the quarter table for phase: odd quarters read the table
+      backwards, without branching
+  */
+  const uint32_t index = (phase >> STEP_SHIFT) & (NCO_QUARTER - 1);
+
+  return index ^ (-((phase >> 30) & 1) & (NCO_QUARTER - 1));
+}
+
+static inline uint32_t
+nco_render_frames (void *out, unsigned long count, const nco_table *t,
+                   uint32_t phase, uint32_t step, int channels)
+{
+  /*  The body of nco_render(). The second half cycle is negated with a
+      mask rather than a branch, and every channel after the first carries
+      the first inverted, like tc_wavetable().
+  */
+  unsigned long i;
+  int32_t sign;
+  int32_t value;
+  float fvalue;
+  int c;
+
+  switch (t->format)
+    {
+    case TC_INT24:
+      for (i = 0; i < count; i++)
+        {
+          sign = -(int32_t)(phase >> 31);
+          value = (t->quarter.i[nco_index (phase)] ^ sign) - sign;
+          tc_pack24 ((unsigned char *)out + i * channels * 3, value);
+          for (c = 1; c < channels; c++)
+            {
+              tc_pack24 ((unsigned char *)out + (i * channels + c) * 3,
+                         -value);
+            }
+          phase += step;
+        }
+      break;
+    case TC_INT32:
+      for (i = 0; i < count; i++)
+        {
+          sign = -(int32_t)(phase >> 31);
+          value = (t->quarter.i[nco_index (phase)] ^ sign) - sign;
+          ((int32_t *)out)[i * channels] = value;
+          for (c = 1; c < channels; c++)
+            {
+              ((int32_t *)out)[i * channels + c] = -value;
+            }
+          phase += step;
+        }
+      break;
+    case TC_FLOAT32:
+      for (i = 0; i < count; i++)
+        {
+          fvalue = t->quarter.f[nco_index (phase)]
+                   * (1.0f - (float)(phase >> 31) * 2);
+          ((float *)out)[i * channels] = fvalue;
+          for (c = 1; c < channels; c++)
+            {
+              ((float *)out)[i * channels + c] = -fvalue;
+            }
+          phase += step;
+        }
+      break;
+    default:
+      for (i = 0; i < count; i++)
+        {
+          sign = -(int32_t)(phase >> 31);
+          value = (t->quarter.i[nco_index (phase)] ^ sign) - sign;
+          ((int16_t *)out)[i * channels] = (int16_t)value;
+          for (c = 1; c < channels; c++)
+            {
+              ((int16_t *)out)[i * channels + c] = (int16_t)-value;
+            }
+          phase += step;
+        }
+      break;
+    }
+  return phase;
+}
+
+uint32_t
+nco_render (void *out, unsigned long count, const nco_table *t,
+            uint32_t phase, uint32_t step, int channels)
+{
+  /*  Write count frames of the carrier in the table's format starting at
+      phase, and return the phase following them. The phase wraps around on
+      its own, so any carrier below the Nyquist frequency plays without a
+      wavetable that holds a whole number of its cycles.
+  */
+  /* Let the compiler unroll the channel loop for mono and stereo */
+  if (channels == 1)
+    {
+      return nco_render_frames (out, count, t, phase, step, 1);
+    }
+  if (channels == 2)
+    {
+      return nco_render_frames (out, count, t, phase, step, 2);
+    }
+  return nco_render_frames (out, count, t, phase, step, channels);
+}
+
+bool
+nco_parse_trim (const char *text, double *ppm)
+{
+  /*  Parse a carrier frequency trim given in parts per million on the
+      command line, up to NCO_MAX_TRIM_PPM either way
+  */
+  char *end;
+  double value = strtod (text, &end);
+
+  if (end == text || *end != '\0' || !(fabs (value) <= NCO_MAX_TRIM_PPM))
+    {
+      return false;
+    }
+  *ppm = value;
+  return true;
+}
@@ -0,0 +1,49 @@
+/*  nco: Numerically controlled oscillator for ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef NCO_H
+#define NCO_H
+
+#include "timecode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NCO_QUARTER_BITS (12)
+#define NCO_QUARTER (1 << NCO_QUARTER_BITS) /* Samples in a quarter cycle */
+#define NCO_MAX_TRIM_PPM (1000) /* Largest trim --trim accepts */
+
+/*  One quarter cycle of a waveshape at some amplitude, sampled in the
+    middle of each of NCO_QUARTER equal steps of phase, so the other three
+    quarters are mirror images of it. Samples are kept on the scale of the
+    format they are rendered in, as integers for the integer formats.
+*/
+typedef struct
+{
+  tc_format format;
+  union
+  {
+    int32_t i[NCO_QUARTER];
+    float f[NCO_QUARTER];
+  } quarter;
+} nco_table;
+
+void nco_table_init (nco_table *t, const tc_wave *w, double amplitude,
+                     tc_format format);
+uint32_t nco_step (double freq, unsigned long rate);
+uint32_t nco_render (void *out, unsigned long count, const nco_table *t,
+                     uint32_t phase, uint32_t step, int channels);
+bool nco_parse_trim (const char *text, double *ppm);
+
+#endif /* NCO_H */
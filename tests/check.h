@@ -0,0 +1,43 @@
+/*  check: Minimal assertions for the ersatz-jjy and ersatz-wwvb tests
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*  Each test program counts its failed checks in CHECK_FAILURES and
+    returns CHECK_RESULT from main(), so CTest sees a nonzero exit status if
+    any check failed. Exit status 77 tells CTest a test was skipped.
+*/
+#define CHECK(cond) check_report ((cond), #cond, __FILE__, __LINE__)
+#define CHECK_RESULT ((CHECK_FAILURES == 0) ? 0 : 1)
+#define CHECK_SKIPPED (77)
+
+static int CHECK_FAILURES = 0;
+
+static inline bool
+check_report (bool ok, const char *what, const char *file, int line)
+{
+  if (!ok)
+    {
+      fprintf (stderr, "%s:%d: check failed: %s\n", file, line, what);
+      CHECK_FAILURES++;
+    }
+  return ok;
+}
+
+#endif /* CHECK_H */
@@ -0,0 +1,135 @@
+/*  test-direct: Check the spectrum of a second rendered with --direct
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "timecode.h"
+#include "check.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define BLOCK (384)          /* DFT length, giving 500 Hz bins */
+#define LOW_AMPLITUDE (0.1)  /* Amplitude of the JJY low signal state */
+#define IMAGE_BOUND (-92.0)  /* Most any other bin may hold, in dB */
+
+/*  Sum the power in each bin of BLOCK-sample DFTs over count samples, which
+    must be a multiple of BLOCK
+*/
+static void
+block_spectrum (const int16_t *x, unsigned long count,
+                double power[BLOCK / 2 + 1])
+{
+  const double PI = acos (-1);
+  double c[BLOCK];
+  double s[BLOCK];
+  double re;
+  double im;
+  unsigned long start;
+  int k;
+  int i;
+
+  for (i = 0; i < BLOCK; i++)
+    {
+      c[i] = cos (2 * PI * i / BLOCK);
+      s[i] = sin (2 * PI * i / BLOCK);
+    }
+  for (k = 0; k <= BLOCK / 2; k++)
+    {
+      power[k] = 0;
+    }
+  for (start = 0; start < count; start += BLOCK)
+    {
+      for (k = 0; k <= BLOCK / 2; k++)
+        {
+          re = 0;
+          im = 0;
+          for (i = 0; i < BLOCK; i++)
+            {
+              re += x[start + i] * c[(k * i) % BLOCK];
+              im -= x[start + i] * s[(k * i) % BLOCK];
+            }
+          power[k] += re * re + im * im;
+        }
+    }
+}
+
+static void
+check_carrier (unsigned long longwave, unsigned long expected_period)
+{
+  /*  Render one second of a JJY one symbol, half a second of high carrier
+      and then low carrier, straight at the longwave frequency. The carrier
+      bin must hold nearly all of the power, and every other bin, including
+      the one the third harmonic aliases into, must be IMAGE_BOUND down.
+  */
+  const unsigned long period
+      = tc_wavetable_period (TC_DIRECT_RATE, longwave, 1);
+  const int carrier = (int)(longwave * BLOCK / TC_DIRECT_RATE);
+  const int image = (int)((3 * longwave % TC_DIRECT_RATE) * BLOCK
+                          / TC_DIRECT_RATE);
+  const int alias = (image > BLOCK / 2) ? BLOCK - image : image;
+  double power[BLOCK / 2 + 1];
+  double total = 0;
+  double worst = 0;
+  int16_t *wave = malloc (TC_DIRECT_RATE * sizeof *wave);
+  int16_t *high;
+  int16_t *low;
+  tc_wave w;
+  unsigned long index;
+  int k;
+
+  CHECK (period == expected_period);
+  tc_wave_init (&w, TC_SINE, longwave, TC_DIRECT_RATE);
+  high = tc_wavetable (period, (double)longwave / TC_DIRECT_RATE, &w, 1,
+                       TC_INT16, 1);
+  low = tc_wavetable (period, (double)longwave / TC_DIRECT_RATE, &w,
+                      LOW_AMPLITUDE, TC_INT16, 1);
+  if (!CHECK (wave != NULL && high != NULL && low != NULL))
+    {
+      free (wave);
+      free (high);
+      free (low);
+      return;
+    }
+  index = tc_render (wave, TC_DIRECT_RATE / 2, high, period, 0,
+                     sizeof *wave);
+  tc_render (&wave[TC_DIRECT_RATE / 2], TC_DIRECT_RATE / 2, low, period,
+             index, sizeof *wave);
+  block_spectrum (wave, TC_DIRECT_RATE, power);
+  for (k = 0; k <= BLOCK / 2; k++)
+    {
+      total += power[k];
+      if (k != carrier && power[k] > worst)
+        {
+          worst = power[k];
+        }
+    }
+  CHECK (power[carrier] > 0.9999 * total);
+  CHECK (10 * log10 (worst / power[carrier]) < IMAGE_BOUND);
+  CHECK (10 * log10 ((power[alias] + 1e-30) / power[carrier]) < IMAGE_BOUND);
+  printf ("%lu Hz: carrier %.4f%% of power, worst other bin %.1f dB, "
+          "third harmonic alias at %d Hz %.1f dB\n",
+          longwave, 100 * power[carrier] / total,
+          10 * log10 (worst / power[carrier]), alias * TC_DIRECT_RATE / BLOCK,
+          10 * log10 ((power[alias] + 1e-30) / power[carrier]));
+  free (wave);
+  free (high);
+  free (low);
+}
+
+int
+main (void)
+{
+  check_carrier (60000, 16);
+  check_carrier (40000, 24);
+  return CHECK_RESULT;
+}
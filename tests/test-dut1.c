@@ -0,0 +1,109 @@
+/*  test-dut1: Check DUT1 lookups and WWVB bits 36-43 against a fixture
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "dut1.h"
+#include "timecode.h"
+#include "wwvbam.h"
+#include "check.h"
+
+/*  tests/finals.sample gives DUT1 from 2016-12-28 to 2017-01-06, across the
+    leap second at the end of 2016, after two made-up days in December 2014
+    with values out of range
+*/
+#define FIXTURE "finals.sample"
+
+/*  WWVB bits 36-38 are the sign of DUT1, and 40-43 its magnitude in BCD,
+    most significant bit first
+*/
+#define PLUS ((1ULL << 36) | (1ULL << 38))
+#define MINUS (1ULL << 37)
+#define BCD_1 (1ULL << 43)
+#define BCD_2 (1ULL << 42)
+#define BCD_4 (1ULL << 41)
+#define BCD_8 (1ULL << 40)
+
+static time_t
+utc (long year, int month, int mday, int hour)
+{
+  return tc_days_from_civil (year, month, mday) * TC_SECONDS_PER_DAY
+         + hour * 3600;
+}
+
+static void
+check_load (dut1_table *dt)
+{
+  /*  The table keeps one run per change of the rounded value, and ends on
+      the last day with a value
+  */
+  dut1_table missing;
+
+  CHECK (!dut1_table_load (&missing, "no-such-file"));
+  CHECK (missing.count == 0);
+  if (!CHECK (dut1_table_load (dt, FIXTURE)) || !CHECK (dt->count == 5))
+    {
+      return;
+    }
+  CHECK (dt->entries[0].day == tc_days_from_civil (2014, 12, 9));
+  CHECK (dt->entries[2].day == tc_days_from_civil (2016, 12, 28));
+  CHECK (dt->entries[3].day == tc_days_from_civil (2017, 1, 1));
+  CHECK (dt->last_day == tc_days_from_civil (2017, 1, 6));
+}
+
+static void
+check_tenths (dut1_table *dt)
+{
+  /*  Values are rounded to the nearest tenth, and clamped to 0.9s. Days
+      outside the table get 0.
+  */
+  CHECK (dut1_tenths (dt, utc (2014, 12, 8, 23)) == 0);
+  CHECK (dut1_tenths (dt, utc (2014, 12, 9, 0)) == 9);
+  CHECK (dut1_tenths (dt, utc (2014, 12, 10, 12)) == -9);
+  CHECK (dut1_tenths (dt, utc (2016, 12, 31, 23)) == -4);
+  CHECK (dut1_tenths (dt, utc (2017, 1, 1, 0)) == 6);
+  CHECK (dut1_tenths (dt, utc (2017, 1, 5, 12)) == 6);
+  CHECK (dut1_tenths (dt, utc (2017, 1, 6, 23)) == 5);
+  CHECK (dut1_covers (dt, utc (2017, 1, 6, 23)));
+  CHECK (!dut1_covers (dt, utc (2017, 1, 7, 0)));
+  CHECK (dut1_tenths (dt, utc (2017, 1, 7, 0)) == 0);
+  CHECK (dut1_tenths (dt, utc (2030, 1, 1, 0)) == 0);
+}
+
+static void
+check_bits (dut1_table *dt)
+{
+  /* Bits 36-43 as sent on days either side of the leap second */
+  CHECK (wwvb_dut1_bits (dut1_tenths (dt, utc (2016, 12, 31, 12)))
+         == (MINUS | BCD_4));
+  CHECK (wwvb_dut1_bits (dut1_tenths (dt, utc (2017, 1, 1, 12)))
+         == (PLUS | BCD_4 | BCD_2));
+  CHECK (wwvb_dut1_bits (dut1_tenths (dt, utc (2017, 1, 6, 12)))
+         == (PLUS | BCD_4 | BCD_1));
+  CHECK (wwvb_dut1_bits (dut1_tenths (dt, utc (2014, 12, 9, 12)))
+         == (PLUS | BCD_8 | BCD_1));
+  CHECK (wwvb_dut1_bits (dut1_tenths (dt, utc (2014, 12, 10, 12)))
+         == (MINUS | BCD_8 | BCD_1));
+  CHECK (wwvb_dut1_bits (dut1_tenths (dt, utc (2017, 1, 7, 12))) == PLUS);
+}
+
+int
+main (void)
+{
+  dut1_table dt;
+
+  check_load (&dt);
+  check_tenths (&dt);
+  check_bits (&dt);
+  return CHECK_RESULT;
+}
@@ -0,0 +1,203 @@
+/*  test-ecc: Check the WWVB PM Hamming code for every time code word
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "timecode.h"
+#include "wwvbpm.h"
+#include "check.h"
+
+#define DATA_BITS (26) /* Bits of the minute_of_century() word */
+#define CHECK_BITS (5) /* Sent in seconds 17 down to 13 */
+
+static unsigned int
+check_bits (const unsigned long *mins)
+{
+  /* The check bits sent for *mins, with bit p sent in second 17 - p */
+  struct tm t = { 0 };
+  unsigned int bits = 0;
+  int p;
+
+  for (p = 0; p < CHECK_BITS; p++)
+    {
+      t.tm_sec = 17 - p;
+      bits |= (unsigned int)wwvb_pm_ecc (&t, mins) << p;
+    }
+  return bits;
+}
+
+static void
+check_masks (void)
+{
+  /*  Mask p covers exactly the data bits from 1 to 25 whose index has bit
+      p set
+  */
+  uint32_t expected;
+  int p;
+  int i;
+
+  for (p = 0; p < CHECK_BITS; p++)
+    {
+      expected = 0;
+      for (i = 1; i < DATA_BITS; i++)
+        {
+          expected |= (uint32_t)((i >> p) & 1) << i;
+        }
+      CHECK (WWVB_PM_ECC_MASKS[p] == expected);
+    }
+}
+
+static bool
+reference_pm_time (const struct tm *t, const unsigned long *mins)
+{
+  /* The time code bit sent in second t->tm_sec, as first written */
+  int i;
+
+  if (t->tm_sec >= 40)
+    {
+      i = 46 - t->tm_sec;
+    }
+  else if (t->tm_sec >= 30)
+    {
+      i = 45 - t->tm_sec;
+    }
+  else if (t->tm_sec >= 20)
+    {
+      i = 44 - t->tm_sec;
+    }
+  else if (t->tm_sec == 19)
+    {
+      i = 0;
+    }
+  else
+    {
+      /* Only remaining case should be second 18 */
+      i = 25;
+    }
+  return (*mins & (1 << i)) != 0;
+}
+
+static bool
+reference_pm_ecc (const struct tm *t, const unsigned long *mins)
+{
+  /*  The check bit sent in second t->tm_sec as first written, one data bit
+      at a time from the seconds that carry them
+  */
+  int p;
+  int i;
+  bool b;
+  struct tm data_bit_tm;
+
+  p = 17 - t->tm_sec;
+  b = true;
+  data_bit_tm = *t;
+  for (i = 1; i < 26; i++)
+    {
+      if (!((1 << p) & i))
+        {
+          continue;
+        }
+      if (i <= 6)
+        {
+          data_bit_tm.tm_sec = 46 - i;
+        }
+      else if (i <= 15)
+        {
+          data_bit_tm.tm_sec = 45 - i;
+        }
+      else if (i <= 24)
+        {
+          data_bit_tm.tm_sec = 44 - i;
+        }
+      else
+        {
+          data_bit_tm.tm_sec = 18;
+        }
+      b = (b != reference_pm_time (&data_bit_tm, mins));
+    }
+  return b;
+}
+
+static void
+check_century (void)
+{
+  /*  Every minute from 2000-01-01 to 2099-12-31: minute_of_century() counts
+      them up from 0 one at a time, and the check bits from the masks match
+      the original per-second code for each of them
+  */
+  const long first = tc_days_from_civil (2000, 1, 1);
+  const long last = tc_days_from_civil (2099, 12, 31);
+  unsigned long expected_mins = 0;
+  unsigned long mismatches = 0;
+  unsigned long mins;
+  struct tm t;
+  long day;
+  int p;
+
+  for (day = first; day <= last; day++)
+    {
+      tc_breakdown ((time_t)day * TC_SECONDS_PER_DAY, &t);
+      for (t.tm_hour = 0; t.tm_hour < 24; t.tm_hour++)
+        {
+          for (t.tm_min = 0; t.tm_min < 60; t.tm_min++)
+            {
+              mins = minute_of_century (&t);
+              mismatches += mins != expected_mins++;
+              for (p = 0; p < CHECK_BITS; p++)
+                {
+                  t.tm_sec = 17 - p;
+                  if (wwvb_pm_ecc (&t, &mins) != reference_pm_ecc (&t, &mins)
+                      && mismatches++ == 0)
+                    {
+                      fprintf (stderr, "minute %lu: check bit %d differs\n",
+                               mins, p);
+                    }
+                }
+              t.tm_sec = 0;
+            }
+        }
+    }
+  CHECK (mismatches == 0);
+}
+
+static void
+check_syndromes (void)
+{
+  /*  Flipping data bit i from 1 to 25 of any word changes the check bits by
+      i, so a receiver can find and correct it. Bit 0 is not covered.
+  */
+  const unsigned long words[] = { 0, 0x3ffffff, 0x1234567, 0x2aaaaaa,
+                                  0x1555555, 0x0b1c2d3 };
+  unsigned long flipped;
+  size_t w;
+  int i;
+
+  for (w = 0; w < sizeof words / sizeof *words; w++)
+    {
+      for (i = 0; i < DATA_BITS; i++)
+        {
+          flipped = words[w] ^ (1UL << i);
+          CHECK ((check_bits (&words[w]) ^ check_bits (&flipped))
+                 == (unsigned int)i);
+        }
+    }
+}
+
+int
+main (void)
+{
+  check_masks ();
+  check_syndromes ();
+  check_century ();
+  return CHECK_RESULT;
+}
@@ -0,0 +1,248 @@
+/*  test-extended: Check the WWVB extended mode PM frame bit for bit
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "timecode.h"
+#include "wwvbpm.h"
+#include "check.h"
+#include <string.h>
+
+/*  The 127-bit time sequence and 106-bit fixed timing word written out first
+    bit first, as the original release of ersatz-wwvb sent them. They are
+    literals here so that any change to the constants in wwvbpm.c shows up;
+    the time sequence is also checked against the LFSR that generates it.
+*/
+const char *SEQUENCE = "1111111001101101010100010010011001111000111"
+                       "0111010111101001011001010011100100011000101"
+                       "11000010000110100000111110110000001010110";
+const char *TIMING_WORD
+    = "11010001110101100101100110111000110000101101001110100"
+      "10101000010111000101101011011011111111000000100100100";
+
+/*  The whole frame sent from 2025-01-15 00:10 UTC, spelled out one minute
+    per line, first bit first: the time sequence from its
+    start, the fixed timing word, and the time sequence backwards
+*/
+const char *FRAME_2025_01_15_0010[WWVB_EXT_MINUTES] = {
+  "111111100110110101010001001001100111100011101110101111010010",
+  "110010100111001000110001011100001000011010000011111011000000",
+  "101011011010001110101100101100110111000110000101101001110100",
+  "101010000101110001011010110110111111110000001001001000110101",
+  "000000110111110000010110000100001110100011000100111001010011",
+  "010010111101011101110001111001100100100010101011011001111111",
+};
+
+/*  Half hours with a known position in the time sequence: the UTC date and
+    time the frame starts, the AM DST bits 57 and 58 as a two-bit number,
+    and the index of SEQUENCE the frame starts at
+*/
+typedef struct
+{
+  long year;
+  int month;
+  int mday;
+  int hour;
+  int min;
+  unsigned int dst;
+  int start;
+} half_hour;
+
+const half_hour HALF_HOURS[] = {
+  { 2025, 1, 15, 0, 10, 0, 0 },   /* The first half hour of a day */
+  { 2025, 1, 15, 23, 40, 0, 94 }, /* The last half hour of a day */
+  { 2025, 7, 15, 13, 40, 3, 55 }, /* DST all day */
+  { 2025, 3, 9, 5, 40, 2, 102 },  /* DST starting, moved on by 80 */
+  { 2025, 11, 2, 7, 10, 1, 109 }, /* DST ending, moved on by 80 */
+};
+
+static void
+check_constants (void)
+{
+  /*  The constants hold the sequences first bit first in bit 0 of the first
+      word. The time sequence fills all 128 bits, so its last bit is its
+      first again, and the timing word has nothing past its end.
+  */
+  int i;
+
+  CHECK (strlen (SEQUENCE) == 127);
+  CHECK (strlen (TIMING_WORD) == 106);
+  for (i = 0; i < 128; i++)
+    {
+      CHECK (access_bit (HALF_HOUR_SEQ_BITS, i) == (SEQUENCE[i % 127] == '1'));
+    }
+  for (i = 0; i < 128; i++)
+    {
+      CHECK (access_bit (FIXED_TIMING_WORD, i)
+             == (i < 106 && TIMING_WORD[i] == '1'));
+    }
+}
+
+static void
+check_sequence (void)
+{
+  /*  The time sequence is the output of a 7-bit LFSR started from all ones,
+      which is only true of it read in the order it is sent: backwards, it
+      starts 0110101.
+  */
+  char bits[128];
+  int i;
+
+  memset (bits, '1', 7);
+  for (i = 7; i < 127; i++)
+    {
+      bits[i] = '0'
+                + ((bits[i - 2] ^ bits[i - 5] ^ bits[i - 6] ^ bits[i - 7])
+                   & 1);
+    }
+  bits[127] = '\0';
+  CHECK (strcmp (bits, SEQUENCE) == 0);
+}
+
+static void
+check_starts (void)
+{
+  /*  A receiver tells the time of day from where the frame starts in the
+      time sequence, so no two half hours of any day may start in the same
+      place unless they are the same half hour with the same DST state.
+      States are 0 for standard time, 1 for DST, and 2 and 3 for the hours
+      from 04:00 to 10:59 UTC of the days DST starts and ends, when the
+      change is under way somewhere in the US.
+  */
+  int owner[127];
+  struct tm tm;
+  unsigned int dst;
+  int state;
+  int key;
+  int start;
+
+  memset (owner, -1, sizeof owner);
+  memset (&tm, 0, sizeof tm);
+  for (dst = 0; dst < 4; dst++)
+    {
+      for (tm.tm_hour = 0; tm.tm_hour < 24; tm.tm_hour++)
+        {
+          for (tm.tm_min = 10; tm.tm_min < 60; tm.tm_min += 30)
+            {
+              /* Bit 57 is the DST state at the end of the day, 58 at its start */
+              state = (dst == 3 || (dst == 1 && tm.tm_hour < 4)
+                       || (dst == 2 && tm.tm_hour > 10));
+              if (dst == 1 || dst == 2)
+                {
+                  if (tm.tm_hour >= 4 && tm.tm_hour <= 10)
+                    {
+                      state = 4 - dst;
+                    }
+                }
+              key = (tm.tm_hour * 2 + tm.tm_min / 30) * 4 + state;
+              start = half_hour_seq (&tm, dst) - 1;
+              if (!CHECK (start >= 0 && start < 127))
+                {
+                  continue;
+                }
+              if (!CHECK (owner[start] == -1 || owner[start] == key))
+                {
+                  fprintf (stderr, "  %02d:%02d with DST bits %u\n",
+                           tm.tm_hour, tm.tm_min, dst);
+                }
+              owner[start] = key;
+            }
+        }
+    }
+}
+
+static bool
+frame_bit (const uint64_t extended[WWVB_EXT_MINUTES], int frame_sec)
+{
+  return (extended[frame_sec / 60] >> (frame_sec % 60)) & 1;
+}
+
+static void
+check_frame (const half_hour *h)
+{
+  /*  The frame is the time sequence from h->start, the fixed timing word,
+      and the same 127 bits of time sequence again backwards
+  */
+  const time_t t
+      = tc_days_from_civil (h->year, h->month, h->mday) * TC_SECONDS_PER_DAY
+        + h->hour * 3600 + h->min * 60;
+  uint64_t extended[WWVB_EXT_MINUTES];
+  struct tm tm;
+  char expected;
+  int sec;
+  int minute;
+
+  tc_breakdown (t, &tm);
+  CHECK (wwvb_in_extended (&tm));
+  CHECK (half_hour_seq (&tm, h->dst) == h->start + 1);
+  wwvb_build_extended (&tm, h->dst, extended);
+  for (sec = 0; sec < WWVB_EXT_MINUTES * 60; sec++)
+    {
+      if (sec < 127)
+        {
+          expected = SEQUENCE[(h->start + sec) % 127];
+        }
+      else if (sec < 233)
+        {
+          expected = TIMING_WORD[sec - 127];
+        }
+      else
+        {
+          expected = SEQUENCE[(h->start + 359 - sec) % 127];
+        }
+      if (!CHECK (frame_bit (extended, sec) == (expected == '1')))
+        {
+          fprintf (stderr, "  %04ld-%02d-%02d %02d:%02d, second %d\n",
+                   h->year, h->month, h->mday, h->hour, h->min, sec);
+        }
+    }
+  for (minute = 0; minute < WWVB_EXT_MINUTES; minute++)
+    {
+      CHECK (extended[minute] >> 60 == 0);
+    }
+}
+
+static void
+check_spelled_frame (void)
+{
+  /* The first half hour of the test day against the frame written out */
+  const time_t t
+      = tc_days_from_civil (2025, 1, 15) * TC_SECONDS_PER_DAY + 10 * 60;
+  uint64_t extended[WWVB_EXT_MINUTES];
+  struct tm tm;
+  int sec;
+
+  tc_breakdown (t, &tm);
+  wwvb_build_extended (&tm, 0, extended);
+  for (sec = 0; sec < WWVB_EXT_MINUTES * 60; sec++)
+    {
+      CHECK (frame_bit (extended, sec)
+             == (FRAME_2025_01_15_0010[sec / 60][sec % 60] == '1'));
+    }
+}
+
+int
+main (void)
+{
+  size_t i;
+
+  check_constants ();
+  check_sequence ();
+  check_starts ();
+  check_spelled_frame ();
+  for (i = 0; i < sizeof HALF_HOURS / sizeof *HALF_HOURS; i++)
+    {
+      check_frame (&HALF_HOURS[i]);
+    }
+  return CHECK_RESULT;
+}
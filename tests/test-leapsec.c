@@ -0,0 +1,161 @@
+/*  test-leapsec: Check leap second lookups and how the WWVB codes send them
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "leapsec.h"
+#include "timecode.h"
+#include "wwvbam.h"
+#include "wwvbpm.h"
+#include "check.h"
+
+/*  tests/leap-seconds.list has a positive leap second at the end of
+    November 2023 and a negative one at the end of June 2024
+*/
+#define FIXTURE "leap-seconds.list"
+
+static time_t
+utc (long year, int month, int mday, int hour, int min, int sec)
+{
+  return tc_days_from_civil (year, month, mday) * TC_SECONDS_PER_DAY
+         + hour * 3600 + min * 60 + sec;
+}
+
+static void
+check_load (leap_table *lt)
+{
+  leap_table missing;
+
+  CHECK (!leap_table_load (&missing, "no-such-file.list"));
+  CHECK (missing.count == 0);
+  if (!CHECK (leap_table_load (lt, FIXTURE)) || !CHECK (lt->count == 3))
+    {
+      return;
+    }
+  CHECK (lt->expires == utc (2025, 1, 1, 0, 0, 0));
+  /* The first entry only starts the table */
+  CHECK (lt->entries[0].kind == LEAP_NONE);
+  CHECK (lt->entries[1].kind == LEAP_POSITIVE);
+  CHECK (lt->entries[1].month_start == utc (2023, 11, 1, 0, 0, 0));
+  CHECK (lt->entries[1].effective == utc (2023, 12, 1, 0, 0, 0));
+  CHECK (lt->entries[1].tai_offset == 38);
+  CHECK (lt->entries[2].kind == LEAP_NEGATIVE);
+  CHECK (lt->entries[2].month_start == utc (2024, 6, 1, 0, 0, 0));
+}
+
+static void
+check_month_state (leap_table *lt)
+{
+  /*  The warning is given from the first to the last second of the month
+      the leap second ends, and lookups may go back in time
+  */
+  CHECK (leap_month_state (lt, utc (2016, 12, 31, 23, 59, 0)) == LEAP_NONE);
+  CHECK (leap_month_state (lt, utc (2023, 10, 31, 23, 59, 59)) == LEAP_NONE);
+  CHECK (leap_month_state (lt, utc (2023, 11, 1, 0, 0, 0)) == LEAP_POSITIVE);
+  CHECK (leap_month_state (lt, utc (2023, 11, 30, 23, 59, 59))
+         == LEAP_POSITIVE);
+  CHECK (leap_month_state (lt, utc (2023, 12, 1, 0, 0, 0)) == LEAP_NONE);
+  CHECK (leap_month_state (lt, utc (2024, 6, 1, 0, 0, 0)) == LEAP_NEGATIVE);
+  CHECK (leap_month_state (lt, utc (2024, 7, 1, 0, 0, 0)) == LEAP_NONE);
+  CHECK (leap_month_state (lt, utc (2023, 11, 15, 12, 0, 0))
+         == LEAP_POSITIVE);
+  CHECK (leap_month_state (lt, utc (2030, 1, 1, 0, 0, 0)) == LEAP_NONE);
+  CHECK (leap_month_state (lt, utc (2024, 6, 30, 0, 0, 0)) == LEAP_NEGATIVE);
+}
+
+static void
+check_minute_length (leap_table *lt)
+{
+  CHECK (leap_minute_length (lt, utc (2016, 12, 31, 23, 59, 0)) == 60);
+  CHECK (leap_minute_length (lt, utc (2023, 11, 30, 23, 58, 0)) == 60);
+  CHECK (leap_minute_length (lt, utc (2023, 11, 30, 23, 59, 0)) == 61);
+  CHECK (leap_minute_length (lt, utc (2023, 12, 1, 0, 0, 0)) == 60);
+  CHECK (leap_minute_length (lt, utc (2024, 6, 30, 23, 58, 0)) == 60);
+  CHECK (leap_minute_length (lt, utc (2024, 6, 30, 23, 59, 0)) == 59);
+  CHECK (leap_minute_length (lt, utc (2024, 7, 1, 0, 0, 0)) == 60);
+}
+
+static void
+check_wwvb_am (leap_table *lt, time_t minute, int length, bool warning)
+{
+  /*  Bit 56 warns of a leap second all month, and the last minute of the
+      month ends in a marker at second 60 or 58 instead of 59
+  */
+  struct tm tm;
+  unsigned int bcd[TC_FIELD_COUNT];
+  tc_frame f;
+
+  tc_breakdown (minute, &tm);
+  tc_bcd_fields (&tm, bcd);
+  wwvb_encode_frame (bcd, wwvb_leap_flags (leap_month_state (lt, minute)),
+                     leap_minute_length (lt, minute), &f);
+  CHECK (f.length == length);
+  CHECK (tc_frame_symbol (&f, 56) == (warning ? TC_ONE : TC_ZERO));
+  CHECK (tc_frame_symbol (&f, length - 1) == TC_MARKER);
+  if (length > 59)
+    {
+      CHECK (tc_frame_symbol (&f, 58) == TC_ZERO);
+    }
+  if (length > 60)
+    {
+      CHECK (tc_frame_symbol (&f, 59) == TC_ZERO);
+    }
+}
+
+static void
+check_wwvb_pm (leap_table *lt)
+{
+  /*  The PM code says which kind of leap second is coming, in the codeword
+      it shares with the DST state
+  */
+  static const unsigned int EXPECTED[3][4] = {
+    { 0x08, 0x15, 0x16, 0x03 }, /* No leap second */
+    { 0x19, 0x1c, 0x1a, 0x1f }, /* Positive leap second */
+    { 0x04, 0x0e, 0x13, 0x0d }, /* Negative leap second */
+  };
+  const time_t months[3] = { utc (2023, 10, 15, 0, 0, 0),
+                             utc (2023, 11, 15, 0, 0, 0),
+                             utc (2024, 6, 15, 0, 0, 0) };
+  unsigned int dst;
+  int i;
+
+  for (i = 0; i < 3; i++)
+    {
+      for (dst = 0; dst < 4; dst++)
+        {
+          CHECK (wwvb_pm_dst_ls (dst, leap_month_state (lt, months[i]))
+                 == EXPECTED[i][dst]);
+        }
+    }
+}
+
+int
+main (void)
+{
+  leap_table lt;
+
+  check_load (&lt);
+  if (lt.count != 3)
+    {
+      return CHECK_RESULT;
+    }
+  check_month_state (&lt);
+  check_minute_length (&lt);
+  check_wwvb_am (&lt, utc (2023, 10, 31, 23, 59, 0), 60, false);
+  check_wwvb_am (&lt, utc (2023, 11, 1, 0, 0, 0), 60, true);
+  check_wwvb_am (&lt, utc (2023, 11, 30, 23, 59, 0), 61, true);
+  check_wwvb_am (&lt, utc (2023, 12, 1, 0, 0, 0), 60, false);
+  check_wwvb_am (&lt, utc (2024, 6, 30, 23, 59, 0), 59, true);
+  check_wwvb_pm (&lt);
+  return CHECK_RESULT;
+}
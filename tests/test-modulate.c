@@ -0,0 +1,143 @@
+/*  test-modulate: Check that every modulation kernel gives the same samples
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "modulate.h"
+#include "check.h"
+
+#define CARRIERS (65536) /* Every int16 sample value */
+
+/*  Lengths mod_apply() is called with in turn, so that every kernel runs
+    its vector loop and its scalar tail from every alignment
+*/
+const unsigned long LENGTHS[] = { 1, 7, 8, 9, 15, 16, 17, 31, 33, 512, 1000 };
+#define LENGTH_COUNT (sizeof LENGTHS / sizeof *LENGTHS)
+
+const char *KERNELS[] = { "scalar", "sse2", "avx2" };
+#define KERNEL_COUNT (sizeof KERNELS / sizeof *KERNELS)
+
+int16_t CARRIER[CARRIERS];
+int16_t ENVELOPE[CARRIERS];
+int16_t OUT[CARRIERS];
+
+static unsigned long
+check_envelope (const char *kernel, int step)
+{
+  /*  Multiply every step-th carrier sample value by each envelope value
+      from 0 to MOD_UNITY, and count the products that differ from
+      (carrier * envelope) >> 15
+  */
+  const unsigned long count = CARRIERS / step;
+  unsigned long mismatches = 0;
+  unsigned long done;
+  unsigned long n;
+  unsigned long i;
+  size_t length = 0;
+  int32_t e;
+
+  for (i = 0; i < count; i++)
+    {
+      CARRIER[i] = (int16_t)(INT16_MIN + i * step);
+    }
+  for (e = 0; e <= MOD_UNITY; e++)
+    {
+      for (i = 0; i < count; i++)
+        {
+          /* Vary the envelope within a call too */
+          ENVELOPE[i] = (int16_t)((e + i) % (MOD_UNITY + 1));
+        }
+      for (done = 0; done < count; done += n)
+        {
+          n = LENGTHS[length++ % LENGTH_COUNT];
+          n = (n < count - done) ? n : count - done;
+          mod_apply (&OUT[done], &CARRIER[done], &ENVELOPE[done], n,
+                     TC_INT16);
+        }
+      for (i = 0; i < count; i++)
+        {
+          if (OUT[i] != (int16_t)(((int32_t)CARRIER[i] * ENVELOPE[i]) >> 15))
+            {
+              if (mismatches++ == 0)
+                {
+                  fprintf (stderr, "%s: %d * %d gave %d\n", kernel,
+                           CARRIER[i], ENVELOPE[i], OUT[i]);
+                }
+            }
+        }
+    }
+  return mismatches;
+}
+
+static void
+check_float (void)
+{
+  /*  Float samples at full envelope come out unchanged, and at a zero
+      envelope silent
+  */
+  static float carrier[CARRIERS];
+  static float out[CARRIERS];
+  unsigned long changed = 0;
+  unsigned long i;
+
+  for (i = 0; i < CARRIERS; i++)
+    {
+      carrier[i] = (float)(INT16_MIN + (long)i) / 32767.5f;
+      ENVELOPE[i] = MOD_UNITY;
+    }
+  mod_apply (out, carrier, ENVELOPE, CARRIERS, TC_FLOAT32);
+  for (i = 0; i < CARRIERS; i++)
+    {
+      changed += out[i] != carrier[i];
+    }
+  CHECK (changed == 0);
+  changed = 0;
+  for (i = 0; i < CARRIERS; i++)
+    {
+      ENVELOPE[i] = 0;
+    }
+  mod_apply (out, carrier, ENVELOPE, CARRIERS, TC_FLOAT32);
+  for (i = 0; i < CARRIERS; i++)
+    {
+      changed += out[i] != 0.0f;
+    }
+  CHECK (changed == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  /*  By default every 251st carrier value is tried against every envelope
+      value, which takes under a second. With the argument "all", every
+      carrier value is, which takes under a minute even without
+      optimization.
+  */
+  const int step = (argc > 1 && argv[1][0] == 'a') ? 1 : 251;
+  size_t k;
+
+  for (k = 0; k < KERNEL_COUNT; k++)
+    {
+      if (!mod_use (KERNELS[k]))
+        {
+          printf ("%s: not supported here, skipped\n", KERNELS[k]);
+          continue;
+        }
+      if (CHECK (check_envelope (KERNELS[k], step) == 0))
+        {
+          printf ("%s: checked\n", mod_kernel_name ());
+        }
+    }
+  check_float ();
+  CHECK (!mod_use ("mmx"));
+  return CHECK_RESULT;
+}
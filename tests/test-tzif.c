@@ -0,0 +1,236 @@
+/*  test-tzif: Check TZif zone lookups against the C library for every zone
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#define _DEFAULT_SOURCE /* tm_gmtoff, setenv(), tzset() and dirent.h */
+
+#include "tzif.h"
+#include "check.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define NAME_CAP (4096)
+#define STEP (29 * 86400L + 3607) /* Longest gap between times compared */
+#define REPORT_CAP (3) /* Mismatches reported for each zone */
+
+/*  Every zone is compared from 1900 to 2100, which covers its transitions
+    and well over half a century of its footer rule. The C library is slow
+    enough that comparing it every few days would take most of a minute,
+    so each window from tzif_window() is compared at its change and at
+    least every STEP seconds in between.
+*/
+const time_t START = -2208988800; /* 1900-01-01 00:00 UTC */
+const time_t END = 4102444800;    /* 2100-01-01 00:00 UTC */
+
+long ZONES;
+long ZONE_FAILURES;
+
+typedef struct
+{
+  long offset;
+  bool isdst;
+} local_type;
+
+static local_type
+libc_type (time_t t)
+{
+  struct tm tm;
+  local_type l = { 0, false };
+
+  if (localtime_r (&t, &tm) != NULL)
+    {
+      l.offset = tm.tm_gmtoff;
+      l.isdst = tm.tm_isdst > 0;
+    }
+  return l;
+}
+
+static int
+compare (tzif_zone *z, const char *name, time_t t, int reported)
+{
+  /*  Compare tzif_offset() with the C library at t, and report a mismatch
+      if fewer than REPORT_CAP have been. Returns the number of mismatches.
+  */
+  const local_type l = libc_type (t);
+  bool isdst;
+  const long offset = tzif_offset (z, t, &isdst);
+
+  if (offset == l.offset && isdst == l.isdst)
+    {
+      return 0;
+    }
+  if (reported < REPORT_CAP)
+    {
+      fprintf (stderr, "%s at %lld: offset %ld dst %d, C library %ld dst %d\n",
+               name, (long long)t, offset, isdst, l.offset, l.isdst);
+    }
+  return 1;
+}
+
+static int
+compare_window (tzif_zone *z, const char *name, time_t t, time_t *next,
+                int reported)
+{
+  /*  Compare the window from tzif_window() at t with the C library, and set
+      *next to where the following window starts. A window that ends in a
+      change of offset or DST state has to end at the very second the C
+      library's local time type changes. Returns the number of mismatches.
+  */
+  tc_zone_window w;
+  local_type l;
+  int mismatches = 0;
+
+  tzif_window (z, t, &w);
+  for (; t < w.change && t < END; t += STEP)
+    {
+      mismatches += compare (z, name, t, reported + mismatches);
+    }
+  *next = w.change;
+  if (w.change >= END
+      || (w.next_offset == w.offset && w.next_isdst == w.isdst))
+    {
+      return mismatches;
+    }
+  mismatches += compare (z, name, w.change - 1, reported + mismatches);
+  l = libc_type (w.change);
+  if (w.next_offset != l.offset || w.next_isdst != l.isdst)
+    {
+      if (reported + mismatches < REPORT_CAP)
+        {
+          fprintf (stderr, "%s: window changes at %lld to offset %ld "
+                           "dst %d, C library %ld dst %d\n",
+                   name, (long long)w.change, w.next_offset, w.next_isdst,
+                   l.offset, l.isdst);
+        }
+      mismatches++;
+    }
+  return mismatches;
+}
+
+static bool
+is_tzif (const char *path)
+{
+  FILE *f = fopen (path, "rb");
+  char magic[4];
+  bool tzif;
+
+  if (f == NULL)
+    {
+      return false;
+    }
+  tzif = fread (magic, 1, 4, f) == 4 && memcmp (magic, "TZif", 4) == 0;
+  fclose (f);
+  return tzif;
+}
+
+static void
+check_zone (const char *path, const char *name)
+{
+  tzif_zone z;
+  time_t t;
+  int mismatches = 0;
+
+  if (!tzif_open (&z, name))
+    {
+      /* Other files live alongside the zones, such as zone.tab */
+      if (is_tzif (path))
+        {
+          fprintf (stderr, "%s: could not be read\n", name);
+          ZONE_FAILURES++;
+        }
+      return;
+    }
+  setenv ("TZ", name, 1);
+  tzset ();
+  ZONES++;
+  for (t = START; t < END;)
+    {
+      mismatches += compare_window (&z, name, t, &t, mismatches);
+    }
+  tzif_close (&z);
+  if (mismatches > 0)
+    {
+      ZONE_FAILURES++;
+    }
+}
+
+static void
+check_dir (const char *dir, const char *prefix)
+{
+  /*  Check every zone under dir, whose names start with prefix. The posix
+      directory repeats the others, and the right directory holds zones
+      with leap seconds, which are not supported.
+  */
+  char path[NAME_CAP];
+  char name[NAME_CAP];
+  struct dirent *e;
+  struct stat st;
+  DIR *d = opendir (dir);
+
+  if (d == NULL)
+    {
+      return;
+    }
+  while ((e = readdir (d)) != NULL)
+    {
+      if (e->d_name[0] == '.'
+          || (*prefix == '\0'
+              && (strcmp (e->d_name, "posix") == 0
+                  || strcmp (e->d_name, "right") == 0)))
+        {
+          continue;
+        }
+      snprintf (path, sizeof path, "%s/%s", dir, e->d_name);
+      snprintf (name, sizeof name, "%s%s", prefix, e->d_name);
+      if (lstat (path, &st) != 0)
+        {
+          continue;
+        }
+      if (S_ISDIR (st.st_mode))
+        {
+          strncat (name, "/", sizeof name - strlen (name) - 1);
+          check_dir (path, name);
+        }
+      else if (S_ISREG (st.st_mode) || S_ISLNK (st.st_mode))
+        {
+          check_zone (path, name);
+        }
+    }
+  closedir (d);
+}
+
+int
+main (void)
+{
+  const char *dir = getenv ("TZDIR");
+  struct stat st;
+
+  if (dir == NULL)
+    {
+      dir = TZIF_DEFAULT_DIR;
+    }
+  if (stat (dir, &st) != 0 || !S_ISDIR (st.st_mode))
+    {
+      printf ("%s not found, skipped\n", dir);
+      return CHECK_SKIPPED;
+    }
+  check_dir (dir, "");
+  printf ("%ld zones compared, %ld differ from the C library\n", ZONES,
+          ZONE_FAILURES);
+  CHECK (ZONES > 0);
+  CHECK (ZONE_FAILURES == 0);
+  return CHECK_RESULT;
+}
@@ -0,0 +1,563 @@
+/*  timecode: Time code encoding shared by ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "timecode.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  Calendar breakdowns, time zone lookups and clock reads made so far,
+    counted where they are made, for ersatz-wwvb --stats. ersatz-jjy breaks
+    down time in its audio callback, so the count is atomic.
+*/
+static atomic_ulong TIME_CALLS;
+
+/*  Calendar conversions in the proleptic Gregorian calendar, using the
+    days_from_civil() and civil_from_days() algorithms described by Howard
+    Hinnant. Unlike gmtime() and localtime() they use no shared static
+    storage or locks, so they are safe to call from the audio callback.
+*/
+
+long
+tc_days_from_civil (long year, int month, int mday)
+{
+  /* Return the number of days from 1970-01-01 to the given date */
+  long era;
+  long yoe;
+  long doy;
+  long doe;
+
+  year -= (month <= 2);
+  era = ((year >= 0) ? year : year - 399) / 400;
+  yoe = year - era * 400;
+  doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + mday - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+void
+tc_civil_from_days (long days, long *year, int *month, int *mday)
+{
+  /* Inverse of tc_days_from_civil() */
+  long era;
+  long doe;
+  long yoe;
+  long doy;
+  long mp;
+
+  days += 719468;
+  era = ((days >= 0) ? days : days - 146096) / 146097;
+  doe = days - era * 146097;
+  yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  mp = (5 * doy + 2) / 153;
+  *mday = (int)(doy - (153 * mp + 2) / 5 + 1);
+  *month = (int)((mp < 10) ? mp + 3 : mp - 9);
+  *year = yoe + era * 400 + (*month <= 2);
+}
+
+void
+tc_count_time_call (void)
+{
+  /* Count one breakdown, time zone lookup or clock read */
+  atomic_fetch_add_explicit (&TIME_CALLS, 1, memory_order_relaxed);
+}
+
+unsigned long
+tc_time_calls (void)
+{
+  /* Return the number of calls counted by tc_count_time_call() */
+  return atomic_load_explicit (&TIME_CALLS, memory_order_relaxed);
+}
+
+void
+tc_breakdown (time_t t, struct tm *tm)
+{
+  /*  Reentrant replacement for gmtime(). tm_isdst is always 0; add a UTC
+      offset to t first to break down local time.
+  */
+  long days = (long)(t / TC_SECONDS_PER_DAY);
+  long secs = (long)(t % TC_SECONDS_PER_DAY);
+  long year;
+
+  tc_count_time_call ();
+
+  if (secs < 0)
+    {
+      secs += TC_SECONDS_PER_DAY;
+      days -= 1;
+    }
+  tc_civil_from_days (days, &year, &tm->tm_mon, &tm->tm_mday);
+  tm->tm_year = (int)(year - 1900);
+  tm->tm_mon -= 1;
+  tm->tm_yday = (int)(days - tc_days_from_civil (year, 1, 1));
+  tm->tm_wday = (int)(((days % 7) + 11) % 7); /* 1970-01-01 was a Thursday */
+  tm->tm_hour = (int)(secs / 3600);
+  tm->tm_min = (int)((secs / 60) % 60);
+  tm->tm_sec = (int)(secs % 60);
+  tm->tm_isdst = 0;
+}
+
+void
+tc_fixed_window (time_t t, long offset, tc_zone_window *w)
+{
+  /* Window for a zone with a constant UTC offset */
+  w->change = t + TC_WINDOW_DAYS * TC_SECONDS_PER_DAY;
+  w->offset = offset;
+  w->next_offset = offset;
+  w->isdst = false;
+  w->next_isdst = false;
+}
+
+unsigned int
+tc_bcd (unsigned int value)
+{
+  /* Values never exceed 366, so three decimal digits are enough */
+  return ((value / 100) << 8) | (((value / 10) % 10) << 4) | (value % 10);
+}
+
+void
+tc_bcd_fields (const struct tm *t, unsigned int bcd[TC_FIELD_COUNT])
+{
+  bcd[TC_MINUTE] = tc_bcd (t->tm_min);
+  bcd[TC_HOUR] = tc_bcd (t->tm_hour);
+  bcd[TC_YDAY] = tc_bcd (t->tm_yday + 1);
+  bcd[TC_YEAR] = tc_bcd (t->tm_year % 100);
+  bcd[TC_WDAY] = t->tm_wday;
+}
+
+static unsigned int
+bcd_increment (unsigned int bcd)
+{
+  /* Add 1 to a two-digit BCD value, carrying from the ones digit */
+  bcd += 1;
+  if ((bcd & 0xf) == 10)
+    {
+      bcd += 6;
+    }
+  return bcd;
+}
+
+bool
+tc_advance_minute (unsigned int bcd[TC_FIELD_COUNT])
+{
+  /*  Advance the BCD minute and hour fields by one minute. Return false
+      instead if the hour would wrap past 23, because the day, year and
+      weekday fields change too and the caller should rebuild all fields from
+      the calendar.
+  */
+  unsigned int minute = bcd_increment (bcd[TC_MINUTE]);
+  unsigned int hour = bcd[TC_HOUR];
+
+  if (minute == 0x60)
+    {
+      minute = 0;
+      hour = bcd_increment (hour);
+      if (hour == 0x24)
+        {
+          return false;
+        }
+    }
+  bcd[TC_MINUTE] = minute;
+  bcd[TC_HOUR] = hour;
+  return true;
+}
+
+uint64_t
+tc_emit (const tc_bit layout[], int count,
+         const unsigned int bcd[TC_FIELD_COUNT])
+{
+  /*  Return a mask with bit n set if second n of the frame encodes a 1,
+      according to a station's layout table. Seconds that the layout does not
+      mention are left at 0 for the caller to fill in.
+  */
+  uint64_t ones = 0;
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      ones |= (uint64_t)((bcd[layout[i].field] >> layout[i].shift) & 1)
+              << layout[i].second;
+    }
+  return ones;
+}
+
+static uint64_t
+spread_bits (uint32_t x)
+{
+  /* Move bit n of x to bit 2n of the result */
+  uint64_t v = x;
+
+  v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+  v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+  v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
+
+uint64_t
+tc_markers (int length)
+{
+  /*  Return the marker mask for a minute of the given length. If a minute
+      ends in a positive leap second, then second 59 encodes a value of 0 and
+      the leap second 60 is the final marker. Conversely, if a minute ends
+      with a negative leap second, then second 58 is the final marker instead
+      of encoding a value.
+  */
+  const uint64_t inner = TC_MARKER_SECONDS & ~(1ULL << 59);
+
+  if (length > TC_FRAME_SECONDS)
+    {
+      return inner | (1ULL << 60);
+    }
+  if (length < TC_FRAME_SECONDS)
+    {
+      return inner | (1ULL << 58);
+    }
+  return TC_MARKER_SECONDS;
+}
+
+void
+tc_pack_frame (uint64_t ones, uint64_t markers, int length, tc_frame *f)
+{
+  /*  Interleave the ones and markers masks into two-bit symbols. TC_ONE is
+      the low bit of a symbol and TC_MARKER the high bit, so a second that is
+      set in both masks is packed as TC_CALL_SIGN.
+  */
+  f->packed[0] = spread_bits ((uint32_t)ones)
+                 | (spread_bits ((uint32_t)markers) << 1);
+  f->packed[1] = spread_bits ((uint32_t)(ones >> 32))
+                 | (spread_bits ((uint32_t)(markers >> 32)) << 1);
+  f->length = length;
+}
+
+int
+tc_parity (uint64_t bits)
+{
+  /* Even parity bit over bits, i.e. the XOR of all of them */
+  bits ^= bits >> 32;
+  bits ^= bits >> 16;
+  bits ^= bits >> 8;
+  bits ^= bits >> 4;
+  bits ^= bits >> 2;
+  bits ^= bits >> 1;
+  return (int)(bits & 1);
+}
+
+unsigned long
+tc_gcd (unsigned long a, unsigned long b)
+{
+  unsigned long r;
+
+  while (b != 0)
+    {
+      r = a % b;
+      a = b;
+      b = r;
+    }
+  return a;
+}
+
+bool
+tc_parse_rate (const char *text, unsigned long *rate)
+{
+  /*  Parse a sample rate in Hz given on the command line, from TC_MIN_RATE
+      to TC_MAX_RATE
+  */
+  char *end;
+  long value = strtol (text, &end, 10);
+
+  if (end == text || *end != '\0' || value < TC_MIN_RATE
+      || value > TC_MAX_RATE)
+    {
+      return false;
+    }
+  *rate = (unsigned long)value;
+  return true;
+}
+
+unsigned long
+tc_wavetable_period (unsigned long rate, unsigned long num, unsigned long den)
+{
+  /*  The fewest samples at rate that hold a whole number of cycles of a
+      carrier of num/den Hz, so that the wavetable repeats seamlessly. For
+      example, 12 samples at 48kHz hold exactly 5 cycles at 20kHz, and the
+      40000/3 Hz carrier of 40kHz JJY takes 1323 samples at 44.1kHz.
+  */
+  return rate * den / tc_gcd (rate * den, num);
+}
+
+bool
+tc_parse_format (const char *text, tc_format *format)
+{
+  /* Parse a sample format named on the command line */
+  const char *names[] = { "int16", "int24", "int32", "float32" };
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      if (strcmp (text, names[i]) == 0)
+        {
+          *format = (tc_format)i;
+          return true;
+        }
+    }
+  return false;
+}
+
+size_t
+tc_sample_size (tc_format format)
+{
+  /* Bytes in one sample */
+  switch (format)
+    {
+    case TC_INT24:
+      return 3;
+    case TC_INT32:
+    case TC_FLOAT32:
+      return 4;
+    default:
+      return 2;
+    }
+}
+
+double
+tc_full_scale (tc_format format)
+{
+  /* Sample value of a full amplitude peak */
+  switch (format)
+    {
+    case TC_INT24:
+      return 8388607.0;
+    case TC_INT32:
+      return 2147483647.0;
+    case TC_FLOAT32:
+      return 1.0;
+    default:
+      return 32767.0;
+    }
+}
+
+void
+tc_store (void *out, unsigned long i, tc_format format, double value)
+{
+  /*  Write value, on the scale of tc_full_scale(), as sample i of out.
+      Integer formats truncate it towards zero.
+  */
+  switch (format)
+    {
+    case TC_INT24:
+      tc_pack24 ((unsigned char *)out + i * 3, (int32_t)value);
+      break;
+    case TC_INT32:
+      ((int32_t *)out)[i] = (int32_t)value;
+      break;
+    case TC_FLOAT32:
+      ((float *)out)[i] = (float)value;
+      break;
+    default:
+      ((int16_t *)out)[i] = (int16_t)value;
+      break;
+    }
+}
+
+bool
+tc_parse_shape (const char *text, tc_shape *shape)
+{
+  /* Parse a waveshape named on the command line */
+  const char *names[] = { "sine", "clipped", "pulse" };
+  int i;
+
+  for (i = 0; i < 3; i++)
+    {
+      if (strcmp (text, names[i]) == 0)
+        {
+          *shape = (tc_shape)i;
+          return true;
+        }
+    }
+  return false;
+}
+
+static double
+tc_shape_harmonic (tc_shape shape, int n)
+{
+  /*  Sine amplitude of odd harmonic n of shape at a peak of 1, from its
+      Fourier series
+  */
+  const double PI = acos (-1);
+  const double clip = asin (TC_CLIP_LEVEL);
+  double rise;
+
+  switch (shape)
+    {
+    case TC_CLIPPED:
+      /* The sine up to the clip angle, then flat */
+      rise = (n == 1) ? clip / 2 - sin (2 * clip) / 4
+                      : sin ((n - 1) * clip) / (2 * (n - 1))
+                            - sin ((n + 1) * clip) / (2 * (n + 1));
+      return 4 / PI * (rise / TC_CLIP_LEVEL + cos (n * clip) / n);
+    case TC_PULSE:
+      return 4 / (n * PI) * sin (n * PI / 2) * sin (n * PI / 6);
+    default:
+      return (n == 1) ? 1 : 0;
+    }
+}
+
+static double
+tc_wave_sum (const tc_wave *w, double angle)
+{
+  /* Sum of the harmonics of w at angle radians into its cycle */
+  double value = 0;
+  int n;
+
+  for (n = 1; n <= w->harmonics; n += 2)
+    {
+      value += w->gain[n] * sin (n * angle);
+    }
+  return value;
+}
+
+void
+tc_wave_init (tc_wave *w, tc_shape shape, double freq, unsigned long rate)
+{
+  /*  Fill w with the harmonics of shape for a tone of freq Hz that lie
+      below the Nyquist frequency of rate. Higher ones would alias down
+      into the audible range, so at a rate of six times freq or less every
+      shape is a sine.
+  */
+  const double PI = acos (-1);
+  const int steps = 4096;
+  double peak = 0;
+  double value;
+  int n;
+  int i;
+
+  w->harmonics = 1;
+  while (w->harmonics + 2 <= TC_MAX_HARMONIC
+         && (w->harmonics + 2) * freq < rate / 2.0)
+    {
+      w->harmonics += 2;
+    }
+  for (n = 0; n <= TC_MAX_HARMONIC; n++)
+    {
+      w->gain[n] = (n % 2 == 1 && n <= w->harmonics)
+                       ? tc_shape_harmonic (shape, n)
+                       : 0;
+    }
+  /* By symmetry the peak lies in the first quarter cycle */
+  for (i = 0; i <= steps; i++)
+    {
+      value = fabs (tc_wave_sum (w, PI / 2 * i / steps));
+      peak = (value > peak) ? value : peak;
+    }
+  for (n = 1; n <= w->harmonics; n += 2)
+    {
+      w->gain[n] /= peak;
+    }
+}
+
+double
+tc_wave_value (const tc_wave *w, double angle)
+{
+  /*  Value of the waveshape at angle radians into its cycle, clamped to
+      within its peak of 1 in case the peak fell between the steps
+      tc_wave_init() measured it at
+  */
+  const double value = tc_wave_sum (w, angle);
+
+  return (value > 1) ? 1 : (value < -1) ? -1 : value;
+}
+
+void *
+tc_wavetable (unsigned long period, double cycles_per_sample,
+              const tc_wave *w, double amplitude, tc_format format,
+              int channels)
+{
+  /*  Allocate a wavetable of period frames of the waveshape w with the given
+      peak, as a fraction of full amplitude, tiled with tc_tile(). Every
+      channel after the first carries the first inverted, so two channels
+      are in antiphase. Returns NULL if there is not enough memory.
+  */
+  const double PI = acos (-1);
+  const double scale = tc_full_scale (format) * amplitude;
+  const size_t frame = tc_sample_size (format) * channels;
+  void *wt = malloc ((period + TC_RENDER_CHUNK) * frame);
+  unsigned long i;
+  double value;
+  int c;
+
+  if (wt == NULL)
+    {
+      return NULL;
+    }
+  for (i = 0; i < period; i++)
+    {
+      value = scale
+              * tc_wave_value (w, (double)i * 2.0 * PI * cycles_per_sample);
+      for (c = 0; c < channels; c++)
+        {
+          tc_store (wt, i * channels + c, format, (c > 0) ? -value : value);
+        }
+    }
+  tc_tile (wt, period, frame);
+  return wt;
+}
+
+void
+tc_tile (void *wt, unsigned long period, size_t frame)
+{
+  /*  Repeat the first TC_RENDER_CHUNK frames of a wavetable of frames of
+      the given size in bytes after its period, so that wt must hold
+      period + TC_RENDER_CHUNK frames
+  */
+  unsigned char *bytes = wt;
+  unsigned long i;
+
+  for (i = 0; i < TC_RENDER_CHUNK; i++)
+    {
+      memcpy (&bytes[(period + i) * frame], &bytes[(i % period) * frame],
+              frame);
+    }
+}
+
+unsigned long
+tc_render (void *out, unsigned long count, const void *wt,
+           unsigned long period, unsigned long index, size_t frame)
+{
+  /*  Copy count frames of a wavetable tiled by tc_tile() into out, starting
+      at index, and return the index following them. The wavetable index
+      only has to be reduced once per chunk rather than once per frame.
+  */
+  unsigned char *dest = out;
+  const unsigned char *src = wt;
+  unsigned long n;
+
+  while (count > 0)
+    {
+      n = (count < TC_RENDER_CHUNK) ? count : TC_RENDER_CHUNK;
+      memcpy (dest, &src[index * frame], n * frame);
+      dest += n * frame;
+      count -= n;
+      index += n;
+      if (index >= period)
+        {
+          index %= period;
+        }
+    }
+  return index;
+}
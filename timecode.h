@@ -0,0 +1,233 @@
+/*  timecode: Time code encoding shared by ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef TIMECODE_H
+#define TIMECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TC_FRAME_SECONDS (60)
+#define TC_SECONDS_PER_DAY (86400L)
+#define TC_WINDOW_DAYS (400) /* Lifetime of a window without changes */
+
+/*  Samples that tc_render() copies from a wavetable at a time. A wavetable
+    is tiled with this many samples past its period, so a run this long
+    starting at any index is contiguous.
+*/
+#define TC_RENDER_CHUNK (512)
+
+/* Sample rates accepted by --rate, in Hz */
+#define TC_MIN_RATE (8000)
+#define TC_MAX_RATE (768000)
+#define TC_DIRECT_RATE (192000) /* Default rate with --direct */
+#define TC_WAVETABLE_CAP (1UL << 20) /* Longest wavetable, in samples */
+#define TC_MAX_HARMONIC (15) /* Highest harmonic of a waveshape kept */
+#define TC_CLIP_LEVEL (0.5) /* Where the clipped waveshape is cut off */
+
+/*  Sample formats audio can be rendered in, the same as PortAudio's
+    paInt16, paInt24 (packed, in native byte order), paInt32 and paFloat32
+*/
+typedef enum
+{
+  TC_INT16,
+  TC_INT24,
+  TC_INT32,
+  TC_FLOAT32
+} tc_format;
+
+/*  Waveshapes the carrier can be played with: a pure sine, a sine clipped
+    at TC_CLIP_LEVEL, or a pulse of either polarity around each peak, on
+    for a sixth of the cycle each. The fundamental is still the strongest
+    component of both; their third harmonics come out about 12dB and 8dB
+    below a full-scale sine, where a sine has none.
+*/
+typedef enum
+{
+  TC_SINE,
+  TC_CLIPPED,
+  TC_PULSE
+} tc_shape;
+
+/*  A waveshape as the sine amplitudes of its odd harmonics, up to the
+    highest one a sample rate can carry, scaled to a peak of 1. Odd
+    harmonics of sines keep the quarter-wave symmetry of a sine.
+*/
+typedef struct
+{
+  int harmonics;
+  double gain[TC_MAX_HARMONIC + 1];
+} tc_wave;
+
+/* Seconds 0, 9, 19, 29, 39, 49 and 59 carry markers in both JJY and WWVB */
+#define TC_MARKER_SECONDS                                                     \
+  ((1ULL << 0) | (1ULL << 9) | (1ULL << 19) | (1ULL << 29) | (1ULL << 39)    \
+   | (1ULL << 49) | (1ULL << 59))
+
+/* Bit position of a BCD weight within a packed BCD value */
+#define TC_BCD_SHIFT(weight)                                                  \
+  ((weight) == 1     ? 0                                                      \
+   : (weight) == 2   ? 1                                                      \
+   : (weight) == 4   ? 2                                                      \
+   : (weight) == 8   ? 3                                                      \
+   : (weight) == 10  ? 4                                                      \
+   : (weight) == 20  ? 5                                                      \
+   : (weight) == 40  ? 6                                                      \
+   : (weight) == 80  ? 7                                                      \
+   : (weight) == 100 ? 8                                                      \
+                     : 9 /* 200 */)
+
+/* Declare that second sec of a frame carries the given weight of field */
+#define TC_BIT(field, weight, sec)                                            \
+  {                                                                           \
+    (field), TC_BCD_SHIFT (weight), (sec)                                     \
+  }
+
+/* Symbols of the amplitude-modulated time code, as packed into a tc_frame */
+typedef enum
+{
+  TC_ZERO = 0,
+  TC_ONE = 1,
+  TC_MARKER = 2,
+  TC_CALL_SIGN = 3 /* Second keyed with a Morse code station identifier */
+} tc_symbol;
+
+/*  Calendar fields that a station encodes in BCD. Day of the week is never
+    more than 6, so its BCD and binary representations are the same.
+*/
+typedef enum
+{
+  TC_MINUTE,
+  TC_HOUR,
+  TC_YDAY, /* Day of the year, starting from 1 */
+  TC_YEAR, /* Year of the century */
+  TC_WDAY,
+  TC_FIELD_COUNT
+} tc_field;
+
+/* One entry of a station's field layout table */
+typedef struct
+{
+  unsigned char field;
+  unsigned char shift; /* Bit of the field's BCD value, see TC_BCD_SHIFT */
+  unsigned char second;
+} tc_bit;
+
+/*  One minute of the time code, with each second's tc_symbol packed into two
+    bits: second n occupies bits (n % 32) * 2 and up of packed[n / 32]. A
+    minute that ends in a leap second is 61 seconds long, or 59 seconds long
+    for a negative leap second.
+*/
+typedef struct
+{
+  uint64_t packed[2];
+  int length;
+} tc_frame;
+
+/*  The UTC offset and DST state of a time zone around the current time:
+    offset and isdst apply before change, next_offset and next_isdst from
+    change onwards. The window is found
+    ahead of time, so converting a time_t to local time with it does not
+    need any library calls and can be done from the audio callback.
+*/
+typedef struct
+{
+  time_t change;
+  long offset;
+  long next_offset;
+  bool isdst;
+  bool next_isdst;
+} tc_zone_window;
+
+long tc_days_from_civil (long year, int month, int mday);
+void tc_civil_from_days (long days, long *year, int *month, int *mday);
+void tc_count_time_call (void);
+unsigned long tc_time_calls (void);
+void tc_breakdown (time_t t, struct tm *tm);
+void tc_fixed_window (time_t t, long offset, tc_zone_window *w);
+unsigned int tc_bcd (unsigned int value);
+void tc_bcd_fields (const struct tm *t, unsigned int bcd[TC_FIELD_COUNT]);
+bool tc_advance_minute (unsigned int bcd[TC_FIELD_COUNT]);
+uint64_t tc_emit (const tc_bit layout[], int count,
+                  const unsigned int bcd[TC_FIELD_COUNT]);
+uint64_t tc_markers (int length);
+void tc_pack_frame (uint64_t ones, uint64_t markers, int length,
+                    tc_frame *f);
+int tc_parity (uint64_t bits);
+unsigned long tc_gcd (unsigned long a, unsigned long b);
+bool tc_parse_rate (const char *text, unsigned long *rate);
+unsigned long tc_wavetable_period (unsigned long rate, unsigned long num,
+                                   unsigned long den);
+bool tc_parse_format (const char *text, tc_format *format);
+size_t tc_sample_size (tc_format format);
+double tc_full_scale (tc_format format);
+void tc_store (void *out, unsigned long i, tc_format format, double value);
+bool tc_parse_shape (const char *text, tc_shape *shape);
+void tc_wave_init (tc_wave *w, tc_shape shape, double freq,
+                   unsigned long rate);
+double tc_wave_value (const tc_wave *w, double angle);
+void *tc_wavetable (unsigned long period, double cycles_per_sample,
+                    const tc_wave *w, double amplitude, tc_format format,
+                    int channels);
+void tc_tile (void *wt, unsigned long period, size_t frame);
+unsigned long tc_render (void *out, unsigned long count, const void *wt,
+                         unsigned long period, unsigned long index,
+                         size_t frame);
+
+static inline int32_t
+tc_unpack24 (const unsigned char *p)
+{
+  /* Read a packed 24-bit sample */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return (int32_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16
+                   | (uint32_t)p[2] << 8)
+         >> 8;
+#else
+  return (int32_t)((uint32_t)p[2] << 24 | (uint32_t)p[1] << 16
+                   | (uint32_t)p[0] << 8)
+         >> 8;
+#endif
+}
+
+static inline void
+tc_pack24 (unsigned char *p, int32_t value)
+{
+  /* Write the low 24 bits of value as a packed sample */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  p[0] = (unsigned char)(value >> 16);
+  p[1] = (unsigned char)(value >> 8);
+  p[2] = (unsigned char)value;
+#else
+  p[0] = (unsigned char)value;
+  p[1] = (unsigned char)(value >> 8);
+  p[2] = (unsigned char)(value >> 16);
+#endif
+}
+
+static inline long
+tc_zone_offset (const tc_zone_window *w, time_t t)
+{
+  return (t < w->change) ? w->offset : w->next_offset;
+}
+
+static inline tc_symbol
+tc_frame_symbol (const tc_frame *f, int sec)
+{
+  return (tc_symbol)((f->packed[sec / 32] >> ((sec % 32) * 2)) & 3);
+}
+
+#endif /* TIMECODE_H */
@@ -0,0 +1,718 @@
+/*  tzif: Time zone database reader shared by ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "tzif.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TZIF_MMAP
+#endif
+
+#define HEADER_SIZE (44)
+#define TTINFO_SIZE (6)
+#define PATH_CAP (4096)
+#define FOOTER_CAP (128)
+#define DEFAULT_RULE_TIME (7200L) /* Rules take effect at 02:00 by default */
+
+static long
+read_be32 (const unsigned char *p)
+{
+  return (long)(int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+                         | ((uint32_t)p[2] << 8) | p[3]);
+}
+
+static long long
+read_be64 (const unsigned char *p)
+{
+  return (long long)(((uint64_t)(uint32_t)read_be32 (p) << 32)
+                     | (uint32_t)read_be32 (p + 4));
+}
+
+static long
+data_block_size (const unsigned char *header, int time_size)
+{
+  /*  Size of the data block following a TZif header, from the counts of
+      UT/local indicators, standard/wall indicators, leap second records,
+      transitions, local time types and abbreviation characters.
+  */
+  long isutcnt = read_be32 (header + 20);
+  long isstdcnt = read_be32 (header + 24);
+  long leapcnt = read_be32 (header + 28);
+  long timecnt = read_be32 (header + 32);
+  long typecnt = read_be32 (header + 36);
+  long charcnt = read_be32 (header + 40);
+
+  return timecnt * (time_size + 1) + typecnt * TTINFO_SIZE + charcnt
+         + leapcnt * (time_size + 4) + isstdcnt + isutcnt;
+}
+
+/*  POSIX TZ strings, as found in TZ and in TZif footers, such as
+    "EST5EDT,M3.2.0,M11.1.0". Each parser advances *s past what it read and
+    returns false on malformed input.
+*/
+
+static bool
+parse_name (const char **s)
+{
+  const char *p = *s;
+
+  if (*p == '<')
+    {
+      p = strchr (p, '>');
+      if (p == NULL)
+        {
+          return false;
+        }
+      *s = p + 1;
+      return true;
+    }
+  while ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z'))
+    {
+      p++;
+    }
+  if (p - *s < 3)
+    {
+      return false;
+    }
+  *s = p;
+  return true;
+}
+
+static bool
+parse_number (const char **s, long max, long *value)
+{
+  const char *p = *s;
+
+  *value = 0;
+  if (*p < '0' || *p > '9')
+    {
+      return false;
+    }
+  while (*p >= '0' && *p <= '9')
+    {
+      *value = *value * 10 + (*p++ - '0');
+      if (*value > max)
+        {
+          return false;
+        }
+    }
+  *s = p;
+  return true;
+}
+
+static bool
+parse_time (const char **s, long *seconds)
+{
+  /* [+-]hh[:mm[:ss]], where hours may go up to 167 in rule times */
+  long sign = 1;
+  long part;
+
+  if (**s == '+' || **s == '-')
+    {
+      sign = (**s == '-') ? -1 : 1;
+      (*s)++;
+    }
+  if (!parse_number (s, 167, &part))
+    {
+      return false;
+    }
+  *seconds = part * 3600;
+  if (**s == ':')
+    {
+      (*s)++;
+      if (!parse_number (s, 59, &part))
+        {
+          return false;
+        }
+      *seconds += part * 60;
+      if (**s == ':')
+        {
+          (*s)++;
+          if (!parse_number (s, 59, &part))
+            {
+              return false;
+            }
+          *seconds += part;
+        }
+    }
+  *seconds *= sign;
+  return true;
+}
+
+static bool
+parse_date (const char **s, tzif_date *d)
+{
+  long value;
+
+  if (**s == 'M')
+    {
+      d->kind = 'M';
+      (*s)++;
+      if (!parse_number (s, 12, &value) || value < 1 || *(*s)++ != '.')
+        {
+          return false;
+        }
+      d->month = (int)value;
+      if (!parse_number (s, 5, &value) || value < 1 || *(*s)++ != '.')
+        {
+          return false;
+        }
+      d->week = (int)value;
+      if (!parse_number (s, 6, &value))
+        {
+          return false;
+        }
+      d->day = (int)value;
+    }
+  else if (**s == 'J')
+    {
+      d->kind = 'J';
+      (*s)++;
+      if (!parse_number (s, 365, &value) || value < 1)
+        {
+          return false;
+        }
+      d->day = (int)value;
+    }
+  else
+    {
+      d->kind = 'D';
+      if (!parse_number (s, 365, &value))
+        {
+          return false;
+        }
+      d->day = (int)value;
+    }
+  d->time = DEFAULT_RULE_TIME;
+  if (**s == '/')
+    {
+      (*s)++;
+      return parse_time (s, &d->time);
+    }
+  return true;
+}
+
+static bool
+parse_rule (const char *s, tzif_rule *r)
+{
+  long offset;
+
+  if (!parse_name (&s) || !parse_time (&s, &offset))
+    {
+      return false;
+    }
+  /* POSIX offsets count hours west of Greenwich */
+  r->std_offset = -offset;
+  r->dst_offset = r->std_offset;
+  r->has_dst = (*s != '\0');
+  if (!r->has_dst)
+    {
+      return true;
+    }
+  if (!parse_name (&s))
+    {
+      return false;
+    }
+  r->dst_offset = r->std_offset + 3600;
+  if (*s != ',' && *s != '\0')
+    {
+      if (!parse_time (&s, &offset))
+        {
+          return false;
+        }
+      r->dst_offset = -offset;
+    }
+  if (*s == '\0')
+    {
+      /* No dates given; use the current US rules, as glibc does */
+      s = ",M3.2.0,M11.1.0";
+    }
+  if (*s++ != ',' || !parse_date (&s, &r->start) || *s++ != ','
+      || !parse_date (&s, &r->end))
+    {
+      return false;
+    }
+  return *s == '\0';
+}
+
+static long
+rule_day (const tzif_date *d, long year)
+{
+  /* Days from 1970-01-01 to the day of the year given by the rule date */
+  long first = tc_days_from_civil (year, 1, 1);
+  bool leap = (tc_days_from_civil (year + 1, 1, 1) - first) == 366;
+  long day;
+  long month_length;
+
+  switch (d->kind)
+    {
+    case 'J':
+      return first + d->day - 1 + ((leap && d->day >= 60) ? 1 : 0);
+    case 'D':
+      return first + d->day;
+    default:
+      first = tc_days_from_civil (year, d->month, 1);
+      month_length = ((d->month == 12) ? tc_days_from_civil (year + 1, 1, 1)
+                                       : tc_days_from_civil (year,
+                                                             d->month + 1, 1))
+                     - first;
+      /* 1970-01-01 was a Thursday */
+      day = (d->day - ((first % 7) + 11) % 7 + 7) % 7 + (d->week - 1) * 7;
+      while (day >= month_length)
+        {
+          day -= 7;
+        }
+      return first + day;
+    }
+}
+
+static time_t
+rule_change (const tzif_date *d, long year, long offset)
+{
+  /* The UTC time of a rule date, whose time is local time at offset */
+  return (time_t)rule_day (d, year) * TC_SECONDS_PER_DAY + d->time - offset;
+}
+
+static long
+utc_year (time_t t)
+{
+  long days = (long)(t / TC_SECONDS_PER_DAY);
+  long year;
+  int month;
+  int mday;
+
+  if (t % TC_SECONDS_PER_DAY < 0)
+    {
+      days -= 1;
+    }
+  tc_civil_from_days (days, &year, &month, &mday);
+  return year;
+}
+
+static bool
+rule_isdst (const tzif_rule *r, time_t t)
+{
+  /* Whether DST is in effect at t, using the rule dates of t's UTC year */
+  long year = utc_year (t);
+  time_t start;
+  time_t end;
+
+  if (!r->has_dst)
+    {
+      return false;
+    }
+  start = rule_change (&r->start, year, r->std_offset);
+  end = rule_change (&r->end, year, r->dst_offset);
+  if (start < end)
+    {
+      return t >= start && t < end;
+    }
+  return t < end || t >= start;
+}
+
+static void
+rule_window (const tzif_rule *r, time_t t, tc_zone_window *w, time_t *start)
+{
+  /*  Fill in the window around t from the rule alone. The next change is
+      the earliest rule date after t at which the DST state differs, and
+      *start is set to the latest rule date at or before t.
+  */
+  long year = utc_year (t);
+  bool isdst = rule_isdst (r, t);
+  long y;
+  time_t c[2];
+  int i;
+
+  tc_fixed_window (t, isdst ? r->dst_offset : r->std_offset, w);
+  w->isdst = isdst;
+  w->next_isdst = isdst;
+  *start = t - TC_WINDOW_DAYS * TC_SECONDS_PER_DAY;
+  if (!r->has_dst)
+    {
+      return;
+    }
+  for (y = year - 1; y <= year + 1; y++)
+    {
+      c[0] = rule_change (&r->start, y, r->std_offset);
+      c[1] = rule_change (&r->end, y, r->dst_offset);
+      for (i = 0; i < 2; i++)
+        {
+          if (c[i] <= t && c[i] > *start)
+            {
+              *start = c[i];
+            }
+          if (c[i] > t && c[i] < w->change && rule_isdst (r, c[i]) != w->isdst)
+            {
+              w->change = c[i];
+              w->next_isdst = !w->isdst;
+              w->next_offset = w->next_isdst ? r->dst_offset : r->std_offset;
+            }
+        }
+    }
+}
+
+static time_t
+transition_time (const tzif_zone *z, long i)
+{
+  if (z->time_size == 8)
+    {
+      return (time_t)read_be64 (z->times + i * 8);
+    }
+  return (time_t)read_be32 (z->times + i * 4);
+}
+
+static int
+default_type (const tzif_zone *z)
+{
+  /*  Type of times before the first transition: the first standard time
+      type, or the first type if all are DST. This follows glibc.
+  */
+  long i;
+
+  for (i = 0; i < z->typecnt; i++)
+    {
+      if (!z->ttinfo[i * TTINFO_SIZE + 4])
+        {
+          return (int)i;
+        }
+    }
+  return 0;
+}
+
+static bool
+map_file (tzif_zone *z, const char *path)
+{
+  /* Map or read the whole file at path into z->map */
+#ifdef TZIF_MMAP
+  int fd = open (path, O_RDONLY);
+  struct stat st;
+  void *map;
+
+  if (fd < 0)
+    {
+      return false;
+    }
+  if (fstat (fd, &st) != 0 || st.st_size < HEADER_SIZE)
+    {
+      close (fd);
+      return false;
+    }
+  map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      return false;
+    }
+  z->map = map;
+  z->map_size = (size_t)st.st_size;
+  return true;
+#else
+  FILE *f = fopen (path, "rb");
+  unsigned char *buf;
+  long size;
+
+  if (f == NULL)
+    {
+      return false;
+    }
+  if (fseek (f, 0, SEEK_END) != 0 || (size = ftell (f)) < HEADER_SIZE
+      || fseek (f, 0, SEEK_SET) != 0)
+    {
+      fclose (f);
+      return false;
+    }
+  buf = malloc ((size_t)size);
+  if (buf == NULL || fread (buf, 1, (size_t)size, f) != (size_t)size)
+    {
+      free (buf);
+      fclose (f);
+      return false;
+    }
+  fclose (f);
+  z->map = buf;
+  z->map_size = (size_t)size;
+  return true;
+#endif
+}
+
+static bool
+parse_file (tzif_zone *z)
+{
+  /*  Locate the transition data in z->map, preferring the 64-bit data of
+      version 2 and later files, and parse the footer rule if present.
+  */
+  const unsigned char *header = z->map;
+  const unsigned char *end = z->map + z->map_size;
+  const unsigned char *data;
+  const unsigned char *footer;
+  char rule[FOOTER_CAP];
+  size_t length;
+  long i;
+
+  if (memcmp (header, "TZif", 4) != 0)
+    {
+      return false;
+    }
+  z->time_size = 4;
+  if (header[4] >= '2')
+    {
+      header += HEADER_SIZE + data_block_size (header, 4);
+      if (header + HEADER_SIZE > end || memcmp (header, "TZif", 4) != 0)
+        {
+          return false;
+        }
+      z->time_size = 8;
+    }
+  data = header + HEADER_SIZE;
+  footer = data + data_block_size (header, z->time_size);
+  /* Leap second corrections ("right/" zones) are not supported */
+  if (footer > end || read_be32 (header + 28) != 0)
+    {
+      return false;
+    }
+  z->timecnt = read_be32 (header + 32);
+  z->typecnt = read_be32 (header + 36);
+  if (z->timecnt < 0 || z->typecnt < 1)
+    {
+      return false;
+    }
+  z->times = data;
+  z->types = data + z->timecnt * z->time_size;
+  z->ttinfo = z->types + z->timecnt;
+  for (i = 0; i < z->timecnt; i++)
+    {
+      if (z->types[i] >= z->typecnt)
+        {
+          return false;
+        }
+    }
+  z->has_rule = false;
+  if (z->time_size == 8 && footer < end && *footer == '\n')
+    {
+      footer++;
+      for (length = 0; footer + length < end && footer[length] != '\n';
+           length++)
+        {
+        }
+      if (length > 0 && length < FOOTER_CAP && footer + length < end)
+        {
+          memcpy (rule, footer, length);
+          rule[length] = '\0';
+          z->has_rule = parse_rule (rule, &z->rule);
+        }
+    }
+  return true;
+}
+
+static void
+set_type (const tzif_zone *z, int type, long *offset, bool *isdst)
+{
+  const unsigned char *info = z->ttinfo + type * TTINFO_SIZE;
+
+  *offset = read_be32 (info);
+  *isdst = info[4] != 0;
+}
+
+static void
+find_window (const tzif_zone *z, time_t t, tc_zone_window *w, time_t *start)
+{
+  /*  Fill in the offset window around t, and set *start to a time at or
+      before t from which the window's offset has been in effect.
+      Transitions are found by binary search; after the last one, the
+      footer rule takes over. Only transitions that change the offset or
+      DST state end a window.
+  */
+  long lo = 0;
+  long hi = z->timecnt;
+  long mid;
+  long i;
+  time_t last;
+  time_t rule_start;
+  tc_zone_window rule;
+
+  tc_count_time_call ();
+  if (z->has_rule
+      && (z->map == NULL
+          || (z->timecnt > 0 && t >= transition_time (z, z->timecnt - 1))))
+    {
+      rule_window (&z->rule, t, w, start);
+      if (z->timecnt > 0 && *start < transition_time (z, z->timecnt - 1))
+        {
+          *start = transition_time (z, z->timecnt - 1);
+        }
+      return;
+    }
+  /* Find the number of transitions at or before t */
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (transition_time (z, mid) <= t)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  set_type (z, (lo == 0) ? default_type (z) : z->types[lo - 1], &w->offset,
+            &w->isdst);
+  *start = (lo == 0) ? t - TC_WINDOW_DAYS * TC_SECONDS_PER_DAY
+                     : transition_time (z, lo - 1);
+  for (i = lo; i < z->timecnt; i++)
+    {
+      set_type (z, z->types[i], &w->next_offset, &w->next_isdst);
+      if (w->next_offset != w->offset || w->next_isdst != w->isdst)
+        {
+          w->change = transition_time (z, i);
+          return;
+        }
+    }
+  w->change = t + TC_WINDOW_DAYS * TC_SECONDS_PER_DAY;
+  w->next_offset = w->offset;
+  w->next_isdst = w->isdst;
+  if (z->has_rule && z->timecnt > 0)
+    {
+      /* The rule takes over at the last transition */
+      last = transition_time (z, z->timecnt - 1);
+      rule_window (&z->rule, last, &rule, &rule_start);
+      if (rule.offset != w->offset || rule.isdst != w->isdst)
+        {
+          w->change = last;
+          w->next_offset = rule.offset;
+          w->next_isdst = rule.isdst;
+        }
+      else
+        {
+          w->change = rule.change;
+          w->next_offset = rule.next_offset;
+          w->next_isdst = rule.next_isdst;
+        }
+    }
+}
+
+void
+tzif_window (const tzif_zone *z, time_t t, tc_zone_window *w)
+{
+  /* Fill in the offset window starting at t */
+  time_t start;
+
+  find_window (z, t, w, &start);
+}
+
+bool
+tzif_open (tzif_zone *z, const char *name)
+{
+  /*  Open a zone the way the C library interprets TZ: name is a zone name
+      such as "Asia/Tokyo" relative to TZDIR, an absolute path to a TZif
+      file, or failing those a POSIX TZ string. Without a name, the TZ
+      environment variable is used, or /etc/localtime if it is not set.
+      Returns false if the zone cannot be found or read.
+  */
+  char path[PATH_CAP];
+  const char *dir = getenv ("TZDIR");
+
+  z->map = NULL;
+  z->map_size = 0;
+  z->timecnt = 0;
+  z->typecnt = 0;
+  z->has_rule = false;
+  if (name == NULL)
+    {
+      name = getenv ("TZ");
+      if (name == NULL)
+        {
+          name = TZIF_DEFAULT_LOCALTIME;
+        }
+    }
+  if (*name == ':')
+    {
+      name++;
+    }
+  if (*name == '\0')
+    {
+      name = "UTC0";
+    }
+  if (dir == NULL)
+    {
+      dir = TZIF_DEFAULT_DIR;
+    }
+  if (*name == '/')
+    {
+      snprintf (path, sizeof (path), "%s", name);
+    }
+  else
+    {
+      snprintf (path, sizeof (path), "%s/%s", dir, name);
+    }
+  if (map_file (z, path))
+    {
+      if (!parse_file (z))
+        {
+          tzif_close (z);
+          return false;
+        }
+    }
+  else if (!parse_rule (name, &z->rule))
+    {
+      return false;
+    }
+  else
+    {
+      z->has_rule = true;
+    }
+  find_window (z, 0, &z->window, &z->window_start);
+  return true;
+}
+
+void
+tzif_close (tzif_zone *z)
+{
+  if (z->map != NULL)
+    {
+#ifdef TZIF_MMAP
+      munmap ((void *)z->map, z->map_size);
+#else
+      free ((void *)z->map);
+#endif
+    }
+  z->map = NULL;
+  z->timecnt = 0;
+}
+
+long
+tzif_offset (tzif_zone *z, time_t t, bool *isdst)
+{
+  /*  Return the UTC offset at t and store the DST state in *isdst if not
+      NULL. Lookups within the cached window take constant time.
+  */
+  const tc_zone_window *w = &z->window;
+
+  if (t < z->window_start || t >= w->change)
+    {
+      find_window (z, t, &z->window, &z->window_start);
+    }
+  if (isdst != NULL)
+    {
+      *isdst = w->isdst;
+    }
+  return w->offset;
+}
@@ -0,0 +1,80 @@
+/*  tzif: Time zone database reader shared by ersatz-jjy and ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef TZIF_H
+#define TZIF_H
+
+#include "timecode.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+/* Where zone names are looked up, unless TZDIR is set */
+#define TZIF_DEFAULT_DIR "/usr/share/zoneinfo"
+/* Zone file used when TZ is not set */
+#define TZIF_DEFAULT_LOCALTIME "/etc/localtime"
+
+/*  Daylight saving time rule from a POSIX TZ string, which TZif files of
+    version 2 and later carry as a footer for times after their last
+    transition. Rule dates are given as kind 'J' (Julian day 1-365 ignoring
+    February 29), 'D' (zero-based day of the year) or 'M' (month, week and
+    weekday), and time is seconds after local midnight.
+*/
+typedef struct
+{
+  char kind;
+  int day;
+  int week;
+  int month;
+  long time;
+} tzif_date;
+
+typedef struct
+{
+  long std_offset; /* UTC offset in seconds east of Greenwich */
+  long dst_offset;
+  bool has_dst;
+  tzif_date start; /* Start of DST, in standard time */
+  tzif_date end;   /* End of DST, in daylight saving time */
+} tzif_rule;
+
+/*  A time zone read from a TZif file, which is memory-mapped and read in
+    place. window caches the offsets around the time of the last lookup, so
+    lookups for steadily increasing times are O(1) until the next
+    transition. A zone is only ever touched by the thread using it and
+    keeps no global state, so several can be used at once.
+*/
+typedef struct
+{
+  const unsigned char *map;
+  size_t map_size;
+  const unsigned char *times; /* Big-endian transition times */
+  const unsigned char *types; /* Local time type index of each transition */
+  const unsigned char *ttinfo; /* Six-byte local time type records */
+  int time_size;               /* 4 for version 1 data, 8 otherwise */
+  long timecnt;
+  long typecnt;
+  tzif_rule rule;
+  bool has_rule;
+  time_t window_start;
+  tc_zone_window window;
+} tzif_zone;
+
+bool tzif_open (tzif_zone *z, const char *name);
+void tzif_close (tzif_zone *z);
+void tzif_window (const tzif_zone *z, time_t t, tc_zone_window *w);
+long tzif_offset (tzif_zone *z, time_t t, bool *isdst);
+
+#endif /* TZIF_H */
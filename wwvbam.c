@@ -0,0 +1,96 @@
+/*  wwvbam: WWVB amplitude modulation time code for ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "wwvbam.h"
+
+/*  Layout of the WWVB AM time code: which weight of which BCD field each
+    second encodes. Seconds not listed here encode markers, DUT1 information,
+    the flags from wwvb_rebuild_fields(), or a constant value of 0.
+*/
+const tc_bit WWVB_LAYOUT[] = {
+  TC_BIT (TC_MINUTE, 40, 1), TC_BIT (TC_MINUTE, 20, 2),
+  TC_BIT (TC_MINUTE, 10, 3), TC_BIT (TC_MINUTE, 8, 5),
+  TC_BIT (TC_MINUTE, 4, 6),  TC_BIT (TC_MINUTE, 2, 7),
+  TC_BIT (TC_MINUTE, 1, 8),  TC_BIT (TC_HOUR, 20, 12),
+  TC_BIT (TC_HOUR, 10, 13),  TC_BIT (TC_HOUR, 8, 15),
+  TC_BIT (TC_HOUR, 4, 16),   TC_BIT (TC_HOUR, 2, 17),
+  TC_BIT (TC_HOUR, 1, 18),   TC_BIT (TC_YDAY, 200, 22),
+  TC_BIT (TC_YDAY, 100, 23), TC_BIT (TC_YDAY, 80, 25),
+  TC_BIT (TC_YDAY, 40, 26),  TC_BIT (TC_YDAY, 20, 27),
+  TC_BIT (TC_YDAY, 10, 28),  TC_BIT (TC_YDAY, 8, 30),
+  TC_BIT (TC_YDAY, 4, 31),   TC_BIT (TC_YDAY, 2, 32),
+  TC_BIT (TC_YDAY, 1, 33),   TC_BIT (TC_YEAR, 80, 45),
+  TC_BIT (TC_YEAR, 40, 46),  TC_BIT (TC_YEAR, 20, 47),
+  TC_BIT (TC_YEAR, 10, 48),  TC_BIT (TC_YEAR, 8, 50),
+  TC_BIT (TC_YEAR, 4, 51),   TC_BIT (TC_YEAR, 2, 52),
+  TC_BIT (TC_YEAR, 1, 53)
+};
+const int WWVB_LAYOUT_COUNT = (sizeof WWVB_LAYOUT) / (sizeof *WWVB_LAYOUT);
+
+/*  Bits 36-38 and 40-43 of the WWVB time code provide DUT1 information: a
+    sign of 101 for positive or 010 for negative, followed by the magnitude in
+    tenths of a second as four bits weighted 0.8, 0.4, 0.2 and 0.1 seconds.
+    The C standard libraries provide no information about DUT1, so it is
+    read from DUT1_TABLE; without one, this code sends +0.0s and expects
+    that a receiving device will ignore the DUT1 value.
+*/
+uint64_t
+wwvb_dut1_bits (int tenths)
+{
+  const unsigned int magnitude = (tenths < 0) ? -tenths : tenths;
+  uint64_t bits;
+
+  bits = (tenths < 0) ? (1ULL << 37) : ((1ULL << 36) | (1ULL << 38));
+  bits |= (uint64_t)((magnitude >> 3) & 1) << 40;
+  bits |= (uint64_t)((magnitude >> 2) & 1) << 41;
+  bits |= (uint64_t)((magnitude >> 1) & 1) << 42;
+  bits |= (uint64_t)(magnitude & 1) << 43;
+  return bits;
+}
+
+bool
+wwvb_b55 (const struct tm *t)
+{
+  const unsigned int year = t->tm_year + 1900;
+
+  return (year % 4 == 0) && ((year % 100 == 0) == (year % 400 == 0));
+}
+
+void
+wwvb_encode_frame (const unsigned int bcd[TC_FIELD_COUNT], uint64_t flags,
+                   int length, tc_frame *f)
+{
+  /*  Encode every second of the AM time code for a minute into f, from its
+      BCD calendar fields, the DUT1 and flag bits that only change once a
+      day, and its length in seconds, which differs from 60 if it ends in a
+      leap second. This runs once per minute, so the audio callback only has
+      to look up one packed symbol at each second boundary.
+  */
+  const uint64_t markers = tc_markers (length);
+  uint64_t ones;
+
+  ones = tc_emit (WWVB_LAYOUT, WWVB_LAYOUT_COUNT, bcd);
+  tc_pack_frame ((ones | flags) & ~markers, markers, length, f);
+}
+
+uint64_t
+wwvb_leap_flags (leap_kind leap)
+{
+  /*  Return AM bit 56, which warns of a leap second at the end of the
+      current month, given the kind of leap second that ends it. The AM
+      code does not say which kind.
+  */
+  return (leap != LEAP_NONE) ? WWVB_LEAP_FLAG : 0;
+}
@@ -0,0 +1,36 @@
+/*  wwvbam: WWVB amplitude modulation time code for ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef WWVBAM_H
+#define WWVBAM_H
+
+#include "leapsec.h"
+#include "timecode.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WWVB_LEAP_FLAG (1ULL << 56) /* AM bit warning of a leap second */
+
+extern const tc_bit WWVB_LAYOUT[];
+extern const int WWVB_LAYOUT_COUNT;
+
+uint64_t wwvb_dut1_bits (int tenths);
+bool wwvb_b55 (const struct tm *t);
+void wwvb_encode_frame (const unsigned int bcd[TC_FIELD_COUNT], uint64_t flags,
+                        int length, tc_frame *f);
+uint64_t wwvb_leap_flags (leap_kind leap);
+
+#endif /* WWVBAM_H */
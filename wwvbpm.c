@@ -0,0 +1,208 @@
+/*  wwvbpm: WWVB phase modulation time code for ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#include "wwvbpm.h"
+#include "timecode.h"
+#include <string.h>
+
+/*  The 127-bit time sequence and 106-bit fixed timing word of the extended
+    mode frame, in the order they are sent: bit i is bit i % 64 of word
+    i / 64, as read by access_bit(). The time sequence repeats every 127
+    bits, and bit 127 holds bit 0 again; it is read modulo 127, so that bit
+    is never used.
+*/
+const unsigned long long HALF_HOUR_SEQ_BITS[]
+    = { 0x34bd771e648ab67f, 0xb5037c1610e8c4e5 };
+const unsigned long long FIXED_TIMING_WORD[]
+    = { 0x42a5cb431d9a6b8b, 0x0000009207fb6b47 };
+
+/*  Codewords for phase modulation bits 47-52 from the enhanced WWVB format,
+    indexed by leap second state (none, none, negative, positive) times four
+    plus the AM DST bits 57 and 58 as a two bit number.
+*/
+const unsigned char WWVB_PM_DST_LS[]
+    = { 0x08, 0x15, 0x16, 0x03, 0x08, 0x15, 0x16, 0x03,
+        0x04, 0x0e, 0x13, 0x0d, 0x19, 0x1c, 0x1a, 0x1f };
+
+/*  Parity-check masks of the Hamming code sent in phase modulation seconds
+    17 down to 13: mask p selects the bits of the 26-bit minute_of_century()
+    word whose index, from 1 to 25, has bit p set.
+*/
+const uint32_t WWVB_PM_ECC_MASKS[]
+    = { 0x2aaaaaa, 0x0cccccc, 0x0f0f0f0, 0x300ff00, 0x3ff0000 };
+
+unsigned long
+minute_of_century (const struct tm *t)
+{
+  /* Minutes since the start of the first year of t's century */
+  const long year = t->tm_year + 1900L;
+  const long days = tc_days_from_civil (year, 1, 1)
+                    - tc_days_from_civil (year - (year % 100), 1, 1)
+                    + t->tm_yday;
+
+  return (unsigned long)days * 1440 + t->tm_hour * 60 + t->tm_min;
+}
+
+bool
+wwvb_pm_time (const struct tm *t, const unsigned long *mins)
+{
+  int i;
+
+  if (t->tm_sec >= 40)
+    {
+      i = 46 - t->tm_sec;
+    }
+  else if (t->tm_sec >= 30)
+    {
+      i = 45 - t->tm_sec;
+    }
+  else if (t->tm_sec >= 20)
+    {
+      i = 44 - t->tm_sec;
+    }
+  else if (t->tm_sec == 19)
+    {
+      i = 0;
+    }
+  else
+    {
+      /* Only remaining case should be second 18 */
+      i = 25;
+    }
+  return (*mins & (1 << i)) != 0;
+}
+
+bool
+wwvb_pm_ecc (const struct tm *t, const unsigned long *mins)
+{
+  /*  Odd-parity Hamming code over the 26 time code bits except bit 0. Bit
+      i of the time code is bit i of *mins, so each check bit is the parity
+      of *mins under one of WWVB_PM_ECC_MASKS.
+  */
+  return !tc_parity (*mins & WWVB_PM_ECC_MASKS[17 - t->tm_sec]);
+}
+
+bool
+access_bit (const unsigned long long a[], int index)
+{
+  return (a[index / 64] >> (index % 64)) & 1;
+}
+
+int
+half_hour_seq (const struct tm *t, unsigned int dst)
+{
+  const bool dst_eod = (dst >> 1) & 1;
+  const bool dst_bod = dst & 1;
+
+  if (!(dst_eod || dst_bod))
+    {
+      return (t->tm_hour * 4) + (t->tm_min / 17) + 1;
+    }
+  else if (dst_eod && dst_bod)
+    {
+      return (t->tm_hour * 4) + (t->tm_min / 17) + 2;
+    }
+  else if (dst_eod && !dst_bod)
+    {
+      if (t->tm_hour <= 3)
+        {
+          return (t->tm_hour * 4) + (t->tm_min / 17) + 1;
+        }
+      else if (t->tm_hour <= 10)
+        {
+          return (t->tm_hour * 4) + (t->tm_min / 17) + 81;
+        }
+      else /* t->tm_hour > 10 */
+        {
+          return (t->tm_hour * 4) + (t->tm_min / 17) + 2;
+        }
+    }
+  else /* !dst_eod && dst_bod */
+    {
+      if (t->tm_hour <= 3)
+        {
+          return (t->tm_hour * 4) + (t->tm_min / 17) + 2;
+        }
+      else if (t->tm_hour <= 10)
+        {
+          return (t->tm_hour * 4) + (t->tm_min / 17) + 82;
+        }
+      else /* t->tm_hour > 10 */
+        {
+          return (t->tm_hour * 4) + (t->tm_min / 17) + 1;
+        }
+    }
+}
+
+bool
+wwvb_in_extended (const struct tm *t)
+{
+  /*  The extended mode PM frame is sent in minutes 10-15 and 40-45 of each
+      hour, in place of the regular one-minute frames.
+  */
+  return t->tm_min % 30 >= WWVB_EXT_FIRST
+         && t->tm_min % 30 < WWVB_EXT_FIRST + WWVB_EXT_MINUTES;
+}
+
+void
+wwvb_build_extended (const struct tm *t, unsigned int dst,
+                     uint64_t extended[WWVB_EXT_MINUTES])
+{
+  /*  Fill in the 360 seconds of the extended mode frame that starts in the
+      half hour of t: the 127-bit time sequence from the position given by
+      half_hour_seq(), the 106-bit fixed timing word, and then the time
+      sequence again in reverse.
+  */
+  const int seq = half_hour_seq (t, dst);
+  int frame_sec;
+  bool b;
+
+  memset (extended, 0, WWVB_EXT_MINUTES * sizeof *extended);
+  for (frame_sec = 0; frame_sec < WWVB_EXT_MINUTES * 60; frame_sec++)
+    {
+      if (frame_sec < 127)
+        {
+          b = access_bit (HALF_HOUR_SEQ_BITS, (seq - 1 + frame_sec) % 127);
+        }
+      else if (frame_sec < 233)
+        {
+          b = access_bit (FIXED_TIMING_WORD, frame_sec - 127);
+        }
+      else /* frame_sec >= 233 */
+        {
+          b = access_bit (HALF_HOUR_SEQ_BITS, (seq + 358 - frame_sec) % 127);
+        }
+      extended[frame_sec / 60] |= (uint64_t)b << (frame_sec % 60);
+    }
+}
+
+unsigned int
+wwvb_pm_dst_ls (unsigned int dst, leap_kind leap)
+{
+  /*  Return the five bit DST and leap second word sent in phase modulation
+      bits 47, 48, 50, 51 and 52, with bit 47 as the most significant bit.
+  */
+  const unsigned int index = dst & 3;
+
+  switch (leap)
+    {
+    case LEAP_POSITIVE:
+      return WWVB_PM_DST_LS[12 + index];
+    case LEAP_NEGATIVE:
+      return WWVB_PM_DST_LS[8 + index];
+    default:
+      return WWVB_PM_DST_LS[index];
+    }
+}
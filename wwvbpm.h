@@ -0,0 +1,42 @@
+/*  wwvbpm: WWVB phase modulation time code for ersatz-wwvb
+    Copyright (C) 2024-2025 Dominic Delabruere
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+#ifndef WWVBPM_H
+#define WWVBPM_H
+
+#include "leapsec.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WWVB_EXT_FIRST (10)  /* Minute of each half hour starting it */
+#define WWVB_EXT_MINUTES (6) /* Length of the extended mode PM frame */
+
+extern const unsigned long long HALF_HOUR_SEQ_BITS[];
+extern const unsigned long long FIXED_TIMING_WORD[];
+extern const unsigned char WWVB_PM_DST_LS[];
+extern const uint32_t WWVB_PM_ECC_MASKS[];
+
+unsigned long minute_of_century (const struct tm *t);
+bool wwvb_pm_time (const struct tm *t, const unsigned long *mins);
+bool wwvb_pm_ecc (const struct tm *t, const unsigned long *mins);
+bool access_bit (const unsigned long long a[], int index);
+int half_hour_seq (const struct tm *t, unsigned int dst);
+bool wwvb_in_extended (const struct tm *t);
+void wwvb_build_extended (const struct tm *t, unsigned int dst,
+                          uint64_t extended[WWVB_EXT_MINUTES]);
+unsigned int wwvb_pm_dst_ls (unsigned int dst, leap_kind leap);
+
+#endif /* WWVBPM_H */